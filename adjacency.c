@@ -0,0 +1,180 @@
+// Adjacency index
+//
+// the edges leaving and entering every node, in compressed sparse rows: the
+// edges of node v in direction `dir` are edges[dir][start[dir][v]] to
+// edges[dir][start[dir][v + 1] - 1], in id order. adjacency_build() makes the
+// rows from the edge list in O(V + E) with a counting sort.
+//
+// edits don't move the rows. an edge removed from the rows only has its bit
+// cleared in `built`, and the edges added since the build are linked in a list
+// per node and direction through `head` and `next`. a query visits the row,
+// skipping the edges removed, then the list, so it stays proportional to the
+// degree of the node. once the edits reach a quarter of the edges of the build
+// adjacency_stale() tells to build the rows again, which is amortized O(1) per
+// edit.
+//
+//     for (AdjCursor c = adjacency_begin(adj, AD_OUT, v); adjacency_next(adj, AD_OUT, v, &c); )
+//         visit(c.e);
+
+#define ADJ_MIN_EDITS 1024      // edits before a rebuild, whatever the size
+
+enum AdjDir {
+    AD_OUT,     // edges from the node
+    AD_IN,      // edges to the node
+};
+
+typedef struct Adjacency {
+    int num_nodes;          // nodes of the last build, the rows
+    int num_edges;          // edges of the last build
+    int *start[2];          // num_nodes + 1 offsets in `edges`, by AdjDir
+    int *edges[2];
+    uint64_t *built;        // bitset: edges in the rows not removed since the build
+
+    // edges added since the build
+    int *head[2];           // per node, first edge of its list, -1 for none
+    int *next[2];           // per edge, next edge of the list it is in
+    int num_added;
+    int num_removed;        // from the rows
+} Adjacency;
+
+// position of a query, the edge visited is `e`
+typedef struct AdjCursor {
+    int k;
+    int end;                // of the row, -1 in the list
+    int e;
+} AdjCursor;
+
+inline internal AdjCursor adjacency_begin(Adjacency *adj, enum AdjDir dir, int v)
+{
+    AdjCursor c = {0, 0, -1};
+    if (v < adj->num_nodes) {
+        c.k = adj->start[dir][v];
+        c.end = adj->start[dir][v + 1];
+    }
+    return c;
+}
+
+// move `c` to the next edge of `v`, false when there are no more
+inline internal bool adjacency_next(Adjacency *adj, enum AdjDir dir, int v, AdjCursor *c)
+{
+    if (c->end >= 0) {
+        while (c->k < c->end) {
+            int e = adj->edges[dir][c->k++];
+            if (bitset_get(adj->built, e)) {
+                c->e = e;
+                return true;
+            }
+        }
+        c->end = -1;
+        c->e = ((size_t)v < da_size(adj->head[dir]))? adj->head[dir][v] : -1;
+    } else {
+        c->e = adj->next[dir][c->e];
+    }
+    return c->e >= 0;
+}
+
+// append to `out`, in arena `a`, the edges of `v` in both directions, a loop once
+void adjacency_incident(Adjacency *adj, Graph *g, int v, Arena *a, int **out)
+{
+    for (AdjCursor c = adjacency_begin(adj, AD_OUT, v); adjacency_next(adj, AD_OUT, v, &c); )
+        arena_da_append(a, *out, c.e);
+    for (AdjCursor c = adjacency_begin(adj, AD_IN, v); adjacency_next(adj, AD_IN, v, &c); )
+        if (g->from[c.e] != v) arena_da_append(a, *out, c.e);
+}
+
+// build the rows of the edges of `g`, the lists are emptied
+void adjacency_build(Adjacency *adj, Graph *g)
+{
+    int n = graph_num_nodes(g);
+    int m = graph_num_edges(g);
+    int *ends[2] = {g->from, g->to};
+
+    da_size(adj->built) = 0;
+    graph_append_zeros(adj->built, BITSET_WORDS(m));
+    graph_foreach_edge(g, e)
+        if (graph_edge_alive(g, e)) bitset_set(adj->built, e);
+
+    for (int dir = 0; dir < 2; dir++) {
+        int *end = ends[dir];
+        da_size(adj->start[dir]) = 0;
+        graph_append_zeros(adj->start[dir], n + 1);
+        int *s = adj->start[dir];
+        graph_foreach_edge(g, e)
+            if (graph_edge_alive(g, e)) s[end[e] + 1]++;
+        for (int v = 0; v < n; v++) s[v + 1] += s[v];
+
+        // the heads are the write positions, then emptied
+        da_resize(adj->head[dir], n);
+        int *pos = adj->head[dir];
+        memcpy(pos, s, n*sizeof(*pos));
+        da_resize(adj->edges[dir], s[n]);
+        graph_foreach_edge(g, e)
+            if (graph_edge_alive(g, e)) adj->edges[dir][pos[end[e]]++] = e;
+        for (int v = 0; v < n; v++) pos[v] = -1;
+
+        da_resize(adj->next[dir], m);
+    }
+    adj->num_nodes = n;
+    adj->num_edges = m;
+    adj->num_added = 0;
+    adj->num_removed = 0;
+}
+
+// grow `da` to `size` items set to `value`
+internal void adjacency_grow(int **da, size_t size, int value)
+{
+    while (da_size(*da) < size) da_append(*da, value);
+}
+
+// the edge `e`, added to the graph or in a slot reused, from node `from` to `to`
+void adjacency_add_edge(Adjacency *adj, int e, int from, int to)
+{
+    int ends[2] = {from, to};
+    for (int dir = 0; dir < 2; dir++) {
+        int v = ends[dir];
+        adjacency_grow(&adj->head[dir], v + 1, -1);
+        adjacency_grow(&adj->next[dir], e + 1, -1);
+        adj->next[dir][e] = adj->head[dir][v];
+        adj->head[dir][v] = e;
+    }
+    adj->num_added++;
+}
+
+// the edge `e` from `from` to `to`, before it is removed from the graph
+void adjacency_remove_edge(Adjacency *adj, int e, int from, int to)
+{
+    if (e < adj->num_edges && bitset_get(adj->built, e)) {
+        bitset_unset(adj->built, e);
+        adj->num_removed++;
+        return;
+    }
+    int ends[2] = {from, to};
+    for (int dir = 0; dir < 2; dir++) {
+        int *p = adj->head[dir] + ends[dir];
+        while (*p != e) {
+            assert(*p >= 0 && "edge not in the adjacency");
+            p = adj->next[dir] + *p;
+        }
+        *p = adj->next[dir][e];
+    }
+    adj->num_added--;
+}
+
+// when the edits since the build are worth building again
+inline internal bool adjacency_stale(Adjacency *adj)
+{
+    int edits = adj->num_added + adj->num_removed;
+    return edits >= ADJ_MIN_EDITS && 4*edits >= adj->num_edges;
+}
+
+void adjacency_free(Adjacency *adj)
+{
+    for (int dir = 0; dir < 2; dir++) {
+        da_free(adj->start[dir]);
+        da_free(adj->edges[dir]);
+        da_free(adj->head[dir]);
+        da_free(adj->next[dir]);
+    }
+    da_free(adj->built);
+    *adj = (Adjacency){0};
+}
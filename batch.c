@@ -0,0 +1,131 @@
+// Batched edge renderer
+//
+// draw_edge() issues a spline, a triangle fan and a text per edge, and the
+// texture switches between shapes and text split the rlgl batch into many small
+// draw calls. here the curves, arrows and label backgrounds of all the visible
+// edges are tessellated into one CPU side triangle buffer and submitted in one
+// go with a private rlgl batch large enough to hold a lot of edges per draw call.
+// the labels are drawn after that, all with the same font texture. the buffer
+// is a temporary of the frame, in an arena the owner resets between frames.
+//
+// only rlBegin/rlVertex level calls are used, so it also works with the
+// software/Mesa GL backends.
+
+#define BEZIER_SEGMENTS 24          // same as raylib's SPLINE_SEGMENT_DIVISIONS
+#define BATCH_BUFFER_ELEMENTS (1 << 16)
+
+typedef struct EdgeBatch {
+    Arena *arena;       // of verts and colors
+    Vector2 *verts;     // 3 per triangle
+    Color *colors;      // 1 per triangle
+    rlRenderBatch rl;
+    bool rl_loaded;
+} EdgeBatch;
+
+inline internal void batch_begin(EdgeBatch *b)
+{
+    b->verts  = NULL;
+    b->colors = NULL;
+}
+
+// raylib culls back faces: keep all the triangles counter-clockwise on screen
+inline internal void batch_triangle(EdgeBatch *b, Vector2 v1, Vector2 v2, Vector2 v3, Color c)
+{
+    float cross = (v2.x - v1.x)*(v3.y - v1.y) - (v2.y - v1.y)*(v3.x - v1.x);
+    if (cross > 0) {
+        Vector2 t = v2;
+        v2 = v3;
+        v3 = t;
+    }
+    Vector2 tri[3] = {v1, v2, v3};
+    arena_da_append_many(b->arena, b->verts, tri, 3);
+    arena_da_append(b->arena, b->colors, c);
+}
+
+void batch_rect(EdgeBatch *b, Rectangle r, Color c)
+{
+    Vector2 tl = {r.x, r.y};
+    Vector2 tr = {r.x + r.width, r.y};
+    Vector2 bl = {r.x, r.y + r.height};
+    Vector2 br = {r.x + r.width, r.y + r.height};
+    batch_triangle(b, tl, bl, br, c);
+    batch_triangle(b, tl, br, tr, c);
+}
+
+// thick cubic Bezier curve through p[0]..p[3], as a strip of quads
+void batch_bezier(EdgeBatch *b, Vector2 *p, float thick, int segments, Color c)
+{
+    Vector2 prev = p[0];
+    Vector2 prev_l = {0}, prev_r = {0};
+    for (int i = 1; i <= segments; i++) {
+        float t = (float)i/segments;
+        float u = 1.0f - t;
+        float k0 = u*u*u, k1 = 3*t*u*u, k2 = 3*t*t*u, k3 = t*t*t;
+        Vector2 cur = {
+            k0*p[0].x + k1*p[1].x + k2*p[2].x + k3*p[3].x,
+            k0*p[0].y + k1*p[1].y + k2*p[2].y + k3*p[3].y,
+        };
+
+        Vector2 dir = Vector2Normalize(Vector2Subtract(cur, prev));
+        Vector2 side = Vector2Scale(Vector2CounterRight(dir), thick/2);
+        Vector2 cur_l = Vector2Add(cur, side);
+        Vector2 cur_r = Vector2Subtract(cur, side);
+        if (i == 1) {
+            prev_l = Vector2Add(prev, side);
+            prev_r = Vector2Subtract(prev, side);
+        }
+
+        batch_triangle(b, prev_l, prev_r, cur_r, c);
+        batch_triangle(b, prev_l, cur_r, cur_l, c);
+
+        prev = cur;
+        prev_l = cur_l;
+        prev_r = cur_r;
+    }
+}
+
+// add the curve, the arrow and the label background of an edge. the number of
+// segments of the curve follows its length on screen
+void batch_edge(EdgeBatch *b, EdgeGeo *geo, int id, GraphCtx *ctx)
+{
+    Color color = edge_color(id, ctx);
+    int segments = lod_curve_segments(geo, ctx->zoom_coef, BEZIER_SEGMENTS);
+    batch_bezier(b, geo->points, EDGE_THICKNESS, segments, color);
+    batch_triangle(b, geo->points[EI_TIP], geo->points[EI_B1], geo->points[EI_B2], color);
+    if (ctx->id_type == IT_LABEL && ctx->focused.id == id && lod_show_labels(ctx->zoom_coef))
+        batch_rect(b, label_rect(geo), graph_color(GC_LABEL_BACKGROUND_HOVER));
+}
+
+// submit all the triangles added since batch_begin()
+void batch_flush(EdgeBatch *b)
+{
+    if (!b->rl_loaded) {
+        b->rl = rlLoadRenderBatch(1, BATCH_BUFFER_ELEMENTS);
+        b->rl_loaded = true;
+    }
+
+    rlSetRenderBatchActive(&b->rl);
+    rlSetTexture(rlGetTextureIdDefault());
+    rlBegin(RL_TRIANGLES);
+    rlTexCoord2f(0.0f, 0.0f);
+    size_t num_triangles = da_size(b->colors);
+    for (size_t i = 0; i < num_triangles; i++) {
+        // starts a new draw call when the buffer is full
+        rlCheckRenderBatchLimit(3);
+        Color c = b->colors[i];
+        Vector2 *v = b->verts + 3*i;
+        rlColor4ub(c.r, c.g, c.b, c.a);
+        rlVertex2f(v[0].x, v[0].y);
+        rlVertex2f(v[1].x, v[1].y);
+        rlVertex2f(v[2].x, v[2].y);
+    }
+    rlEnd();
+    rlSetTexture(0);
+    rlSetRenderBatchActive(NULL);
+}
+
+void batch_free(EdgeBatch *b)
+{
+    if (b->rl_loaded) rlUnloadRenderBatch(b->rl);
+    *b = (EdgeBatch){0};
+}
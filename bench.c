@@ -0,0 +1,810 @@
+// graphbench: headless benchmark of the frame pipeline
+//
+// generates synthetic graphs and drives the same app_update()/app_draw() code as
+// graphgui, in a hidden window, with a scripted mouse: hovering, dragging nodes,
+// zooming and panning. for every graph size it prints one JSON object per line
+// with the percentiles of the frame time and of its phases.
+//
+// usage:
+//     ./graphbench [--sizes 1000,10000,100000,1000000] [--frames 300] [--trace file.json]
+//                  [--no-layer]
+//     ./graphbench --render [num_edges]
+//     ./graphbench --io [--sizes ...]
+//     ./graphbench --import file
+//     ./graphbench --layout [--sizes ...]
+//     ./graphbench --hierarchy [--sizes ...]
+//     ./graphbench --geo [num_edges]
+//     ./graphbench --pick [num_edges]
+//     ./graphbench --churn [num_edits] [--sizes ...]
+//     ./graphbench --handles [num_ops] [--sizes ...]
+//
+// sizes are numbers of nodes, every graph has twice as many edges. --render
+// compares the per-edge and the batched edge renderers drawing a whole graph.
+// --trace records the profiler zones of all the runs as a Chrome trace.
+// --no-layer draws the whole graph every frame instead of through the layer
+// cache. --io times saving and loading the graphs with the binary file format,
+// and saving a loaded graph over its own file. --import measures the throughput
+// of the text importers. --layout times the iterations of the force-directed
+// layout, --hierarchy the phases of the layered layout. --geo compares the
+// throughput of compute_edge_geo() with the batched SIMD kernels. --pick times
+// picking points on and around the edge curves against a scan of all of them.
+// --churn adds and removes random nodes and edges, with the geometry updates and
+// the compactions of the app, and counts the edits the layer cache would miss
+// (stale_layers). --handles compares the items held by raw index and by Handle
+// through the same node removals and additions. --threads sets the size of the
+// job pool, one thread per core by default.
+
+#define GRAPHGUI_NO_MAIN
+#include "graph.c"
+
+#define BENCH_WIDTH 1280
+#define BENCH_HEIGHT 720
+#define BENCH_WARMUP_FRAMES 5
+#define BENCH_RENDER_FRAMES 60
+#define BENCH_NODE_SPACING 300.0f
+#define BENCH_SCRIPT_PERIOD 120     // frames of one hover/drag/zoom/pan cycle
+#define BENCH_LAYOUT_ITERATIONS 20
+#define BENCH_GEO_PASSES 10
+#define BENCH_CHURN_FRAME 1000      // edits between two geometry updates
+#define BENCH_HELD_ITEMS 4096       // nodes held by --handles
+#define BENCH_SELECT_PX 320.0f      // side on screen of the region dragged by the script
+#define BENCH_PICK_QUERIES 100000
+#define BENCH_PICK_SCANS 200        // of the queries, checked against a scan of all the curves
+
+internal uint32_t bench_rand(uint32_t *state)
+{
+    // xorshift32
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+internal float bench_randf(uint32_t *state, float min, float max)
+{
+    return min + (max - min)*(bench_rand(state) & 0xffffff)/(float)0xffffff;
+}
+
+// nodes on a square grid, each edge going to one of the 8 neighbours of its source
+internal void bench_make_graph(Graph *g, int num_nodes, int num_edges, uint32_t seed)
+{
+    int side = (int)ceilf(sqrtf((float)num_nodes));
+    for (int i = 0; i < num_nodes; i++) {
+        Vector2 pos = {(i % side)*BENCH_NODE_SPACING, (i / side)*BENCH_NODE_SPACING};
+        graph_add_node(g, pos);
+    }
+
+    const char *labels[] = {"a", "b", "edge", "label", "hello", "world"};
+    uint32_t state = seed;
+    for (int i = 0; i < num_edges; i++) {
+        int from = bench_rand(&state) % num_nodes;
+        int dx = (int)(bench_rand(&state) % 3) - 1;
+        int dy = (int)(bench_rand(&state) % 3) - 1;
+        int to = from + dy*side + dx;
+        if (to < 0 || to >= num_nodes) to = from;
+        Vector2 c1 = {bench_randf(&state, -120, 120), bench_randf(&state, -120, 120)};
+        Vector2 c2 = {bench_randf(&state, -120, 120), bench_randf(&state, -120, 120)};
+        graph_add_edge(g, from, to, c1, c2, (Vector2){0}, labels[i % ARRAYSIZE(labels)]);
+    }
+}
+
+internal int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// sorts `samples`
+internal double percentile(double *samples, int n, double p)
+{
+    qsort(samples, n, sizeof(*samples), cmp_double);
+    int i = (int)(p*(n - 1) + 0.5);
+    return samples[i];
+}
+
+// node closest to the center of the graphics area, where the script grabs it
+internal int bench_node_near_center(GraphApp *app)
+{
+    Rectangle ga = app->graphics_area;
+    Vector2 center = GetScreenToWorld2D((Vector2){ga.x + ga.width/2, ga.y + ga.height/2},
+            app->camera);
+    int best = -1;
+    float best_d = INFINITY;
+    graph_foreach_node(&app->g, i) {
+        float d = Vector2DistanceSqr(graph_node_pos(&app->g, i), center);
+        if (d < best_d) {
+            best_d = d;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// scripted input for `frame`: sweep the mouse over the graph, then drag the
+// nodes of a region around the center, zoom in and out and pan
+internal FrameInput bench_script(GraphApp *app, int frame, Vector2 *mouse)
+{
+    FrameInput in = {0};
+    Rectangle ga = app->graphics_area;
+    Vector2 center = {ga.x + ga.width/2, ga.y + ga.height/2};
+    int t = frame % BENCH_SCRIPT_PERIOD;
+
+    Vector2 prev = *mouse;
+    if (t < 40) {
+        // hover
+        float a = t/40.0f;
+        *mouse = (Vector2){ga.x + a*ga.width, ga.y + (0.5f + 0.4f*sinf(a*2*PI))*ga.height};
+    } else if (t == 40) {
+        // select the nodes around the one grabbed, as a rubber band would, so
+        // the drag moves them all and their edges are rebuilt every frame
+        int node = bench_node_near_center(app);
+        Vector2 pos = graph_node_pos(&app->g, node);
+        float half = BENCH_SELECT_PX/2/app->camera.zoom;
+        selection_clear(&app->sel);
+        app_select_rect(app, (Rectangle){pos.x - half, pos.y - half, 2*half, 2*half});
+        *mouse = GetWorldToScreen2D(pos, app->camera);
+    } else if (t == 41) {
+        in.left_pressed = true;
+    } else if (t < 70) {
+        // drag
+        *mouse = Vector2Add(*mouse, (Vector2){4, 3});
+    } else if (t == 70) {
+        in.left_released = true;
+    } else if (t < 85) {
+        *mouse = center;
+        in.wheel = 1.0f;
+    } else if (t < 100) {
+        *mouse = center;
+        in.wheel = -1.0f;
+    } else {
+        // pan back and forth
+        in.right_down = true;
+        *mouse = Vector2Add(*mouse, (Vector2){(t < 110)? 10 : -10, 0});
+    }
+    in.mouse = *mouse;
+    in.mouse_delta = Vector2Subtract(*mouse, prev);
+    return in;
+}
+
+internal void bench_pipeline(int num_nodes, int num_frames, bool cached_layer)
+{
+    GraphApp app;
+    app_init(&app, BENCH_WIDTH, BENCH_HEIGHT);
+    app.ctx.cached_layer = cached_layer;
+    bench_make_graph(&app.g, num_nodes, 2*num_nodes, 0x2545f491);
+
+    double setup_start = now_ms();
+    app_sync_graph(&app);
+    app_update_geometry(&app);
+    double setup_ms = now_ms() - setup_start;
+
+    // start zoomed out, on the middle of the graph
+    float extent = ceilf(sqrtf((float)num_nodes))*BENCH_NODE_SPACING;
+    app.camera.zoom = 0.05f;
+    app.camera.target = (Vector2){extent/2 - BENCH_WIDTH/2/app.camera.zoom,
+            extent/2 - BENCH_HEIGHT/2/app.camera.zoom};
+
+    double *frame_ms    = malloc(num_frames*sizeof(double));
+    double *update_ms   = malloc(num_frames*sizeof(double));
+    double *hit_test_ms = malloc(num_frames*sizeof(double));
+    double *geometry_ms = malloc(num_frames*sizeof(double));
+    double *draw_ms     = malloc(num_frames*sizeof(double));
+    double rebuilt = 0;
+    int redraws = 0;
+
+    Vector2 mouse = {0};
+    for (int frame = -BENCH_WARMUP_FRAMES; frame < num_frames; frame++) {
+        FrameInput in = bench_script(&app, (frame < 0)? 0 : frame, &mouse);
+        double start = now_ms();
+        app_begin_frame(&app);
+        app_update(&app, &in);
+        app_draw(&app);
+        if (frame < 0) continue;
+        frame_ms[frame]    = now_ms() - start;
+        update_ms[frame]   = prof_ms(PZ_INPUT);
+        hit_test_ms[frame] = prof_ms(PZ_HIT_TEST);
+        geometry_ms[frame] = prof_ms(PZ_GEOMETRY);
+        draw_ms[frame]     = prof_ms(PZ_DRAW);
+        rebuilt += app.stats.edges_rebuilt;
+        if (frame == 0) redraws = app.layer.redraws;
+    }
+    redraws = app.layer.redraws - redraws;
+
+    printf("{\"nodes\": %d, \"edges\": %d, \"frames\": %d, \"setup_ms\": %.3f, "
+            "\"frame_ms_p50\": %.3f, \"frame_ms_p99\": %.3f, "
+            "\"update_ms_p50\": %.3f, \"update_ms_p99\": %.3f, "
+            "\"hit_test_ms_p50\": %.4f, \"hit_test_ms_p99\": %.4f, "
+            "\"geometry_ms_p50\": %.4f, \"geometry_ms_p99\": %.4f, "
+            "\"draw_ms_p50\": %.3f, \"draw_ms_p99\": %.3f, "
+            "\"edges_rebuilt_avg\": %.1f, \"frame_arena_kb\": %zu, \"layer_redraws\": %d}\n",
+            graph_num_nodes(&app.g), graph_num_edges(&app.g), num_frames, setup_ms,
+            percentile(frame_ms, num_frames, 0.5), percentile(frame_ms, num_frames, 0.99),
+            percentile(update_ms, num_frames, 0.5), percentile(update_ms, num_frames, 0.99),
+            percentile(hit_test_ms, num_frames, 0.5), percentile(hit_test_ms, num_frames, 0.99),
+            percentile(geometry_ms, num_frames, 0.5), percentile(geometry_ms, num_frames, 0.99),
+            percentile(draw_ms, num_frames, 0.5), percentile(draw_ms, num_frames, 0.99),
+            rebuilt/num_frames, app.frame.high_water/1024, redraws);
+    fflush(stdout);
+
+    free(frame_ms);
+    free(update_ms);
+    free(hit_test_ms);
+    free(geometry_ms);
+    free(draw_ms);
+    app_free(&app);
+}
+
+// average frame time in milliseconds drawing all the edges
+internal double bench_draw(Camera2D camera, int *ids, EdgeGeo *geo, Graph *g, EdgeBatch *batch,
+        GraphCtx *ctx)
+{
+    double start = 0;
+    for (int frame = 0; frame < BENCH_WARMUP_FRAMES + BENCH_RENDER_FRAMES; frame++) {
+        if (frame == BENCH_WARMUP_FRAMES) start = GetTime();
+        arena_reset(batch->arena);
+        BeginDrawing();
+            ClearBackground(BACKGROUND_COLOR);
+            BeginMode2D(camera);
+                draw_edges(ids, geo, g, batch, ctx);
+            EndMode2D();
+        EndDrawing();
+    }
+    return 1000.0*(GetTime() - start)/BENCH_RENDER_FRAMES;
+}
+
+internal void bench_render(int num_edges)
+{
+    int num_nodes = (num_edges/2 > 0)? num_edges/2 : 1;
+
+    GraphApp app;
+    app_init(&app, BENCH_WIDTH, BENCH_HEIGHT);
+    bench_make_graph(&app.g, num_nodes, num_edges, 0x2545f491);
+    app_sync_graph(&app);
+    app_update_geometry(&app);
+
+    int *ids = NULL;
+    graph_foreach_edge(&app.g, i)
+        da_append(ids, i);
+
+    // fit the whole grid on screen
+    float extent = ceilf(sqrtf((float)num_nodes))*BENCH_NODE_SPACING;
+    Camera2D camera = {0};
+    camera.zoom = BENCH_HEIGHT/extent;
+    app.ctx.zoom_coef = 1.0f/camera.zoom;
+
+    app.ctx.batched = false;
+    double per_edge = bench_draw(camera, ids, app.gc.geo, &app.g, &app.batch, &app.ctx);
+    app.ctx.batched = true;
+    double batched = bench_draw(camera, ids, app.gc.geo, &app.g, &app.batch, &app.ctx);
+
+    printf("{\"edges\": %d, \"frames\": %d, \"per_edge_ms\": %.3f, \"batched_ms\": %.3f}\n",
+            num_edges, BENCH_RENDER_FRAMES, per_edge, batched);
+
+    da_free(ids);
+    app_free(&app);
+}
+
+internal void bench_io(int num_nodes)
+{
+    const char *path = "graphbench.grph";
+    GraphApp app;
+    app_init(&app, BENCH_WIDTH, BENCH_HEIGHT);
+    bench_make_graph(&app.g, num_nodes, 2*num_nodes, 0x2545f491);
+
+    double start = now_ms();
+    graph_save(&app.g, path);
+    double save_ms = now_ms() - start;
+
+    start = now_ms();
+    Graph g = {0};
+    bool ok = graph_load(&g, path);
+    double load_ms = now_ms() - start;
+    assert(ok);
+    size_t bytes = g.mapped_size;
+    graph_free(&app.g);
+    app.g = g;
+
+    // building the caches reads every page of the file
+    start = now_ms();
+    app_sync_graph(&app);
+    app_update_geometry(&app);
+    double sync_ms = now_ms() - start;
+
+    // saving over the file the graph is mapped from, as Ctrl+S does after a load
+    app.g.x[5] += 1.0f;
+    start = now_ms();
+    ok = graph_save(&app.g, path);
+    double resave_ms = now_ms() - start;
+    assert(ok);
+    Graph again = {0};
+    ok = graph_load(&again, path);
+    assert(ok);
+    assert(graph_num_nodes(&again) == graph_num_nodes(&app.g));
+    assert(graph_num_edges(&again) == graph_num_edges(&app.g));
+    assert(again.x[5] == app.g.x[5]);
+    assert(memcmp(again.label, app.g.label, graph_num_edges(&again)*sizeof(int)) == 0);
+    graph_free(&again);
+
+    printf("{\"nodes\": %d, \"edges\": %d, \"bytes\": %zu, \"save_ms\": %.3f, "
+            "\"load_ms\": %.3f, \"sync_ms\": %.3f, \"resave_ms\": %.3f}\n",
+            graph_num_nodes(&app.g), graph_num_edges(&app.g), bytes, save_ms, load_ms, sync_ms,
+            resave_ms);
+    fflush(stdout);
+
+    app_free(&app);
+    remove(path);
+}
+
+// time of a force-directed layout iteration, starting from the grid
+internal void bench_layout(int num_nodes)
+{
+    Graph g = {0};
+    bench_make_graph(&g, num_nodes, 2*num_nodes, 0x2545f491);
+    Layout l = {0};
+    layout_start(&l, &g);
+
+    double *iter_ms = malloc(BENCH_LAYOUT_ITERATIONS*sizeof(double));
+    for (int i = 0; i < BENCH_LAYOUT_ITERATIONS; i++) {
+        double start = now_ms();
+        layout_iterate(&l, &g);
+        iter_ms[i] = now_ms() - start;
+    }
+
+    printf("{\"nodes\": %d, \"edges\": %d, \"iterations\": %d, \"quad_cells\": %zu, "
+            "\"iteration_ms_p50\": %.3f, \"iteration_ms_p99\": %.3f}\n",
+            graph_num_nodes(&g), graph_num_edges(&g), BENCH_LAYOUT_ITERATIONS, da_size(l.cells),
+            percentile(iter_ms, BENCH_LAYOUT_ITERATIONS, 0.5),
+            percentile(iter_ms, BENCH_LAYOUT_ITERATIONS, 0.99));
+    fflush(stdout);
+
+    free(iter_ms);
+    layout_free(&l);
+    graph_free(&g);
+}
+
+// largest difference between the coordinates of two edge geometries
+internal float bench_geo_error(EdgeGeo *a, EdgeGeo *b)
+{
+    float err = 0;
+    for (int p = 0; p <= EI_BB_MAX; p++) {
+        err = fmaxf(err, fabsf(a->points[p].x - b->points[p].x));
+        err = fmaxf(err, fabsf(a->points[p].y - b->points[p].y));
+    }
+    return err;
+}
+
+// picks at random points, half of them next to a curve, through the spatial
+// index as on a mouse move at zoom 1. the first BENCH_PICK_SCANS are compared
+// with the nearest curve found measuring all of them: a mismatch is a curve
+// picked that isn't the nearest, or a curve missed
+internal void bench_pick(int num_edges)
+{
+    int num_nodes = (num_edges/2 > 0)? num_edges/2 : 1;
+    GraphApp app;
+    app_init(&app, BENCH_WIDTH, BENCH_HEIGHT);
+    bench_make_graph(&app.g, num_nodes, num_edges, 0x2545f491);
+    app_sync_graph(&app);
+    app_update_geometry(&app);
+    Graph *g = &app.g;
+    EdgeGeo *geo = app.gc.geo;
+
+    float extent = ceilf(sqrtf((float)num_nodes))*BENCH_NODE_SPACING;
+    uint32_t state = 0x6b43a9b5;
+    Vector2 *queries = malloc(BENCH_PICK_QUERIES*sizeof(Vector2));
+    for (int i = 0; i < BENCH_PICK_QUERIES; i++) {
+        if (i % 2) {
+            queries[i] = (Vector2){bench_randf(&state, 0, extent), bench_randf(&state, 0, extent)};
+        } else {
+            Vector2 *b = geo[bench_rand(&state) % num_edges].points + EI_BS;
+            Vector2 p = GetSplinePointBezierCubic(b[0], b[1], b[2], b[3], bench_randf(&state, 0, 1));
+            queries[i] = Vector2Add(p, (Vector2){bench_randf(&state, -8, 8), bench_randf(&state, -8, 8)});
+        }
+    }
+
+    int hits = 0;
+    double start = now_ms();
+    for (int i = 0; i < BENCH_PICK_QUERIES; i++)
+        hits += app_pick(&app, queries[i]).edge.type == IT_EDGE;
+    double pick_ms = now_ms() - start;
+
+    float radius = EDGE_THICKNESS/2 + CURVE_PICK_MARGIN;
+    int mismatches = 0;
+    start = now_ms();
+    for (int i = 0; i < BENCH_PICK_SCANS; i++) {
+        float best = radius*radius;
+        int nearest = -1;
+        graph_foreach_edge(g, e) {
+            float d2 = bezier_dist2(queries[i], geo[e].points + EI_BS, best, 0);
+            if (d2 < best) {
+                best = d2;
+                nearest = e;
+            }
+        }
+        SpatialKey picked = app_pick(&app, queries[i]).edge;
+        if (picked.type == IT_EDGE) {
+            float d2 = bezier_dist2(queries[i], geo[picked.id].points + EI_BS, INFINITY, 0);
+            mismatches += d2 > best;
+        } else if (picked.type == IT_NONE) {
+            mismatches += nearest >= 0;
+        }
+    }
+    double scan_ms = now_ms() - start;
+
+    printf("{\"edges\": %d, \"queries\": %d, \"curve_hits\": %d, \"pick_us\": %.3f, "
+            "\"scan_us\": %.1f, \"mismatches\": %d}\n", num_edges, BENCH_PICK_QUERIES, hits,
+            pick_ms*1000.0/BENCH_PICK_QUERIES, scan_ms*1000.0/BENCH_PICK_SCANS, mismatches);
+    fflush(stdout);
+    free(queries);
+    app_free(&app);
+}
+
+// edges per second of compute_edge_geo() and of every kernel of
+// compute_edge_geo_lanes() the CPU runs, over random edges. the lanes are filled
+// from and copied back to the same arrays, as the geometry cache does
+internal void bench_geo(int num_edges)
+{
+    num_edges = (num_edges + GEO_LANES - 1)/GEO_LANES*GEO_LANES;
+    Vector2 *in = malloc(6*num_edges*sizeof(Vector2));     // n1, n2, c1, c2, loffset, lsize
+    EdgeGeo *ref = malloc(num_edges*sizeof(EdgeGeo));
+    EdgeGeo *out = malloc(num_edges*sizeof(EdgeGeo));
+    assert(in && ref && out);
+    uint32_t state = 0x2545f491;
+    for (int i = 0; i < 6*num_edges; i++)
+        in[i] = (Vector2){bench_randf(&state, -1000, 1000), bench_randf(&state, -1000, 1000)};
+    // some null control points, as after a reset
+    for (int i = 0; i < num_edges; i += 97) in[6*i + 2] = (Vector2){0};
+
+    double best = INFINITY;
+    for (int pass = 0; pass < BENCH_GEO_PASSES; pass++) {
+        double start = now_ms();
+        for (int i = 0; i < num_edges; i++) {
+            Vector2 *e = in + 6*i;
+            compute_edge_geo(ref + i, e[0], e[1], e[2], e[3], e[4], e[5]);
+        }
+        best = fmin(best, now_ms() - start);
+    }
+    printf("{\"edges\": %d, \"kernel\": \"compute_edge_geo\", \"edges_per_s\": %.0f}\n",
+            num_edges, num_edges/(best/1000.0));
+
+    const char *names[] = {"compute_edge_geo", "lanes_sse", "lanes_avx"};
+    for (enum GeoSimd simd = GEO_SSE; simd <= geo_simd_best(); simd++) {
+        best = INFINITY;
+        EdgeGeoLanes lanes;
+        for (int pass = 0; pass < BENCH_GEO_PASSES; pass++) {
+            double start = now_ms();
+            for (int i = 0; i < num_edges; i += GEO_LANES) {
+                for (int k = 0; k < GEO_LANES; k++) {
+                    Vector2 *e = in + 6*(i + k);
+                    lanes.n1x[k] = e[0].x; lanes.n1y[k] = e[0].y;
+                    lanes.n2x[k] = e[1].x; lanes.n2y[k] = e[1].y;
+                    lanes.c1x[k] = e[2].x; lanes.c1y[k] = e[2].y;
+                    lanes.c2x[k] = e[3].x; lanes.c2y[k] = e[3].y;
+                    lanes.lox[k] = e[4].x; lanes.loy[k] = e[4].y;
+                    lanes.lw[k] = e[5].x;  lanes.lh[k] = e[5].y;
+                }
+                compute_edge_geo_lanes(&lanes, simd);
+                for (int k = 0; k < GEO_LANES; k++)
+                    edge_geo_lanes_get(&lanes, k, out + i + k);
+            }
+            best = fmin(best, now_ms() - start);
+        }
+
+        float err = 0;
+        for (int i = 0; i < num_edges; i++)
+            err = fmaxf(err, bench_geo_error(ref + i, out + i));
+        printf("{\"edges\": %d, \"kernel\": \"%s\", \"edges_per_s\": %.0f, "
+                "\"max_error\": %g}\n", num_edges, names[simd], num_edges/(best/1000.0), err);
+    }
+    fflush(stdout);
+
+    free(in);
+    free(ref);
+    free(out);
+}
+
+// phases of the layered layout
+internal void bench_hierarchy(int num_nodes)
+{
+    Graph g = {0};
+    bench_make_graph(&g, num_nodes, 2*num_nodes, 0x2545f491);
+    Hierarchy h = {0};
+    double start = now_ms();
+    hierarchy_layout(&h, &g);
+    double ms = now_ms() - start;
+
+    printf("{\"nodes\": %d, \"edges\": %d, \"layers\": %d, \"dummies\": %d, "
+            "\"initial_crossings\": %ld, \"crossings\": %ld, \"sweeps\": %d, "
+            "\"cycles_ms\": %.3f, \"layers_ms\": %.3f, \"order_ms\": %.3f, "
+            "\"coords_ms\": %.3f, \"total_ms\": %.3f}\n",
+            graph_num_nodes(&g), graph_num_edges(&g), h.num_layers, h.num_dummies,
+            h.initial_crossings, h.crossings, h.sweeps, h.cycles_ms, h.layers_ms, h.order_ms,
+            h.coords_ms, ms);
+    fflush(stdout);
+
+    hierarchy_free(&h);
+    graph_free(&g);
+}
+
+internal void bench_import(const char *path)
+{
+    Graph g = {0};
+    double start = now_ms();
+    bool ok = import_file(&g, path, import_format_from_path(path));
+    double ms = now_ms() - start;
+    if (!ok) return;
+
+    graph_free(&g);
+
+    // the same on the worker thread, the batches are appended here as they come
+    Loader l;
+    Graph lg = {0};
+    start = now_ms();
+    if (!loader_start(&l, path, import_format_from_path(path))) return;
+    while (!loader_done(&l)) {
+        ImportBatch b;
+        if (!loader_next(&l, &b)) {
+            // the worker may share the core
+            nanosleep(&(struct timespec){0, LOADER_WAIT_NS}, NULL);
+            continue;
+        }
+        import_batch_apply(&lg, &b, &l.label_map);
+        import_batch_free(&b);
+    }
+    double loader_ms = now_ms() - start;
+    loader_end(&l);
+
+    long bytes = GetFileLength(path);
+    printf("{\"file\": \"%s\", \"bytes\": %ld, \"nodes\": %d, \"edges\": %d, "
+            "\"import_ms\": %.3f, \"mb_per_s\": %.1f, \"loader_ms\": %.3f}\n",
+            path, bytes, graph_num_nodes(&lg), graph_num_edges(&lg), ms, bytes/(ms*1000.0),
+            loader_ms);
+    graph_free(&lg);
+}
+
+internal int bench_live_node(GraphApp *app, uint32_t *state)
+{
+    int i;
+    do i = bench_rand(state) % graph_num_nodes(&app->g); while (!graph_node_alive(&app->g, i));
+    return i;
+}
+
+// random edits on the app: removing nodes with their edges and single edges,
+// adding nodes and edges between random nodes, in about the same numbers so
+// the graph keeps its size
+internal void bench_churn(int num_nodes, int num_edits)
+{
+    GraphApp app;
+    app_init(&app, BENCH_WIDTH, BENCH_HEIGHT);
+    bench_make_graph(&app.g, num_nodes, 2*num_nodes, 0x2545f491);
+    app_sync_graph(&app);
+    app_update_geometry(&app);
+
+    uint32_t state = 0x6b43a9b5;
+    int compactions = 0;
+    double compact_ms = 0;
+    double max_compact_ms = 0;
+    int stale_layers = 0;
+    double start = now_ms();
+    for (int edit = 0; edit < num_edits; edit++) {
+        Graph *g = &app.g;
+        // every edit must show in the layer: it changes the key or invalidates it
+        LayerKey key = app_layer_key(&app);
+        app.layer.valid = true;
+        uint32_t op = bench_rand(&state) % 8;
+        if (op <= 1 && graph_live_nodes(g) > 1) {
+            app_remove_node(&app, bench_live_node(&app, &state));
+        } else if (op <= 3) {
+            Vector2 pos = graph_node_pos(g, bench_live_node(&app, &state));
+            app_add_node(&app, Vector2AddValue(pos, bench_randf(&state, -100, 100)));
+        } else if (op == 4 && graph_live_edges(g) > 0) {
+            int e;
+            do e = bench_rand(&state) % graph_num_edges(g); while (!graph_edge_alive(g, e));
+            app_remove_edge(&app, e);
+        } else {
+            app_add_edge(&app, bench_live_node(&app, &state), bench_live_node(&app, &state));
+        }
+        stale_layers += app.layer.valid && layer_key_equal(key, app_layer_key(&app));
+
+        if ((edit + 1) % BENCH_CHURN_FRAME == 0) {
+            if (adjacency_stale(&app.adj)) adjacency_build(&app.adj, &app.g);
+            app_update_geometry(&app);
+            if (app_fragmented(&app)) {
+                double t = now_ms();
+                app_compact(&app);
+                app_update_geometry(&app);
+                t = now_ms() - t;
+                compactions++;
+                compact_ms += t;
+                max_compact_ms = fmax(max_compact_ms, t);
+            }
+        }
+    }
+    app_update_geometry(&app);
+    double ms = now_ms() - start;
+
+    printf("{\"nodes\": %d, \"edges\": %d, \"edits\": %d, \"edits_per_s\": %.0f, "
+            "\"compactions\": %d, \"compact_ms_avg\": %.3f, \"compact_ms_max\": %.3f, "
+            "\"live_nodes\": %d, \"live_edges\": %d, \"slots\": %d, \"stale_layers\": %d}\n",
+            num_nodes, 2*num_nodes, num_edits, num_edits/(ms - compact_ms)*1000.0, compactions,
+            (compactions)? compact_ms/compactions : 0.0, max_compact_ms, graph_live_nodes(&app.g),
+            graph_live_edges(&app.g), graph_num_nodes(&app.g) + graph_num_edges(&app.g),
+            stale_layers);
+    fflush(stdout);
+
+    app_free(&app);
+}
+
+internal int bench_random_live_node(Graph *g, uint32_t *state)
+{
+    int i;
+    do i = bench_rand(state) % graph_num_nodes(g); while (!graph_node_alive(g, i));
+    return i;
+}
+
+// `num_ops` operations on BENCH_HELD_ITEMS nodes held by raw index, or by
+// handle, with a node removed and one added every 4 operations: the slots
+// freed are reused, so a raw index can end up on another node. a held node
+// found removed, `stale` times, is replaced by another one. returns the time
+internal double bench_handle_pass(int num_nodes, int num_ops, bool handles, int *stale)
+{
+    Graph g = {0};
+    bench_make_graph(&g, num_nodes, 0, 0x2545f491);
+    uint32_t state = 0x6b43a9b5;    // of the edits, the same in both passes
+    uint32_t pick = 0x1f123bb5;     // of the nodes held
+    int *raw = malloc(BENCH_HELD_ITEMS*sizeof(int));
+    Handle *held = malloc(BENCH_HELD_ITEMS*sizeof(Handle));
+    for (int k = 0; k < BENCH_HELD_ITEMS; k++) {
+        raw[k] = bench_rand(&pick) % num_nodes;
+        held[k] = graph_node_handle(&g, raw[k]);
+    }
+
+    *stale = 0;
+    double start = now_ms();
+    for (int op = 0; op < num_ops; op++) {
+        uint32_t r = bench_rand(&state);
+        if (r % 8 == 0 && graph_live_nodes(&g) > 1) {
+            graph_remove_node(&g, bench_random_live_node(&g, &state));
+        } else if (r % 8 == 1) {
+            graph_add_node(&g, (Vector2){bench_randf(&state, 0, 1000), 0});
+        } else {
+            int k = (r >> 3) % BENCH_HELD_ITEMS;
+            int id;
+            if (handles) {
+                id = graph_node_get(&g, held[k]);
+            } else {
+                id = graph_node_alive(&g, raw[k])? raw[k] : -1;
+            }
+            if (id < 0) {
+                (*stale)++;
+                id = bench_random_live_node(&g, &pick);
+                raw[k] = id;
+                held[k] = graph_node_handle(&g, id);
+            }
+            g.x[id] += 1.0f;
+        }
+    }
+    double ms = now_ms() - start;
+
+    free(raw);
+    free(held);
+    graph_free(&g);
+    return ms;
+}
+
+internal void bench_handles(int num_nodes, int num_ops)
+{
+    int raw_stale, handle_stale;
+    double raw_ms = bench_handle_pass(num_nodes, num_ops, false, &raw_stale);
+    double handle_ms = bench_handle_pass(num_nodes, num_ops, true, &handle_stale);
+    // the stale handles not caught by the raw indices are the reused slots
+    printf("{\"nodes\": %d, \"ops\": %d, \"raw_ns_per_op\": %.2f, \"handle_ns_per_op\": %.2f, "
+            "\"raw_stale\": %d, \"handle_stale\": %d}\n",
+            num_nodes, num_ops, raw_ms*1e6/num_ops, handle_ms*1e6/num_ops, raw_stale,
+            handle_stale);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    int sizes[16] = {1000, 10000, 100000, 1000000};
+    int num_sizes = 4;
+    int num_frames = 300;
+    int render_edges = 0;
+    int geo_edges = 0;
+    int pick_edges = 0;
+    int churn_edits = 0;
+    int handle_ops = 0;
+    bool io = false;
+    bool layout = false;
+    bool hierarchy = false;
+    bool cached_layer = true;
+    int num_threads = 0;
+    const char *import_path = NULL;
+    const char *trace_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            num_sizes = 0;
+            for (char *p = argv[++i]; *p && num_sizes < (int)(ARRAYSIZE(sizes)); ) {
+                sizes[num_sizes++] = strtol(p, &p, 10);
+                if (*p == ',') p++;
+            }
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            num_frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--import") == 0 && i + 1 < argc) {
+            import_path = argv[++i];
+        } else if (strcmp(argv[i], "--io") == 0) {
+            io = true;
+        } else if (strcmp(argv[i], "--layout") == 0) {
+            layout = true;
+        } else if (strcmp(argv[i], "--hierarchy") == 0) {
+            hierarchy = true;
+        } else if (strcmp(argv[i], "--no-layer") == 0) {
+            cached_layer = false;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--render") == 0) {
+            render_edges = (i + 1 < argc && argv[i + 1][0] != '-')? atoi(argv[++i]) : 100000;
+        } else if (strcmp(argv[i], "--geo") == 0) {
+            geo_edges = (i + 1 < argc && argv[i + 1][0] != '-')? atoi(argv[++i]) : 1000000;
+        } else if (strcmp(argv[i], "--pick") == 0) {
+            pick_edges = (i + 1 < argc && argv[i + 1][0] != '-')? atoi(argv[++i]) : 100000;
+        } else if (strcmp(argv[i], "--churn") == 0) {
+            churn_edits = (i + 1 < argc && argv[i + 1][0] != '-')? atoi(argv[++i]) : 1000000;
+        } else if (strcmp(argv[i], "--handles") == 0) {
+            handle_ops = (i + 1 < argc && argv[i + 1][0] != '-')? atoi(argv[++i]) : 10000000;
+        } else {
+            fprintf(stderr, "usage: %s [--sizes n1,n2,...] [--frames n] [--trace file] "
+                    "[--render [num_edges]] [--geo [num_edges]] [--pick [num_edges]] [--churn [num_edits]] "
+                    "[--handles [num_ops]] [--io] [--no-layer] "
+                    "[--layout] [--hierarchy] [--import file] [--threads n]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    SetTraceLogLevel(LOG_WARNING);
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(BENCH_WIDTH, BENCH_HEIGHT, "graphbench");
+    SetTargetFPS(0);
+    job_pool_init(&global_jobs, num_threads);
+    if (trace_path) prof_trace_start(trace_path);
+
+    if (import_path) {
+        bench_import(import_path);
+    } else if (render_edges > 0) {
+        bench_render(render_edges);
+    } else if (geo_edges > 0) {
+        bench_geo(geo_edges);
+    } else if (pick_edges > 0) {
+        bench_pick(pick_edges);
+    } else if (churn_edits > 0) {
+        for (int i = 0; i < num_sizes; i++)
+            bench_churn(sizes[i], churn_edits);
+    } else if (handle_ops > 0) {
+        for (int i = 0; i < num_sizes; i++)
+            bench_handles(sizes[i], handle_ops);
+    } else if (io) {
+        for (int i = 0; i < num_sizes; i++)
+            bench_io(sizes[i]);
+    } else if (layout) {
+        for (int i = 0; i < num_sizes; i++)
+            bench_layout(sizes[i]);
+    } else if (hierarchy) {
+        for (int i = 0; i < num_sizes; i++)
+            bench_hierarchy(sizes[i]);
+    } else {
+        for (int i = 0; i < num_sizes; i++)
+            bench_pipeline(sizes[i], num_frames, cached_layer);
+    }
+
+    prof_trace_stop();
+    job_pool_free(&global_jobs);
+    CloseWindow();
+    return 0;
+}
@@ -6,7 +6,8 @@ CFLAGS="-Wall -Wextra -Wstrict-prototypes -ggdb -I${RAYLIB_PATH} -I${RAYGUI_PATH
 CFLAGS="${CFLAGS} -Wno-unused-function -Wno-unused-parameter -Wno-unused-variable" # NOTE(proto): comment to look for unsused
 
 
-gcc $CFLAGS graph.c -o graphgui -L${RAYLIB_PATH} -lraylib -lm
+gcc $CFLAGS graph.c -o graphgui -L${RAYLIB_PATH} -lraylib -lm -lpthread
+gcc $CFLAGS -O2 bench.c -o graphbench -L${RAYLIB_PATH} -lraylib -lm -lpthread
 
 # ============================================================
 set +x
@@ -9,21 +9,46 @@
     using libc:
     - da_append(da, x)
     - da_append_many(da, items, num_items)
+    - da_reserve(da, num_items)     | room for num_items more without growing
+    - da_resize(da, num_items)      | size set to num_items, the new items are not initialized
+    - da_shrink_to_fit(da)          | capacity down to the size
     - da_size(da)
+    - da_cap(da)
     - da_pop(da)
     - da_free(da)
     - sb_append_cstr(sb, str)
 
+    sizes and capacities are size_t. arrays of DA_MMAP_BYTES or more are moved
+    to their own memory mapping, asking for transparent huge pages where the
+    system has them, and grow with mremap() when it is available (define
+    _GNU_SOURCE before including the system headers), so their pages are
+    remapped rather than copied.
+
     NOTE: you can change the size of a dynamic array assigning to `da_size(da)`
     ``` C
     da_size(da) = 0;
     ```
 
+    NOTE: a dynamic array can also live in memory owned by somebody else (e.g. a
+    memory mapped file), preceded by a Dynamic_Array_Header with the flags set to
+    DA_EXTERNAL. it is copied to the heap the first time it grows, and da_free
+    only forgets it.
+
     and the version using arena as allocator
     - arena_da_append(arena, da, x)
     - arena_da_append_many(arena, da, items, num_items)
+    - arena_da_reserve(arena, da, num_items)
     - arena_sb_append_cstr(arena, sb, str)
 
+    ## bitsets
+
+    arrays of uint64_t words, bit `i` is bit i % 64 of word i / 64:
+    - BITSET_WORDS(num_bits)
+    - bitset_get(bits, i)
+    - bitset_set(bits, i)
+    - bitset_unset(bits, i)
+    - int bitset_next(const uint64_t *bits, size_t num_words, int from)
+
     ## arena allocator
 
     void * arena_push_size(Arena *a, size_t size);
@@ -32,8 +57,17 @@
     Arena_Mark arena_snapshot(Arena *a);
     void   arena_rewind(Arena *a, Arena_Mark m);
     void   arena_set_allign(Arena *a, int allign);
+    size_t arena_used(Arena *a);
     void   arena_status(Arena *a);
 
+    a new block is at least twice as large as the one before it, up to
+    ARENA_MAX_GROWTH, and a push that fits in the current block only bumps its
+    offset. resetting an arena that grew to several blocks keeps the largest
+    one and frees the others, so a reset never allocates and an arena reset
+    every frame settles, the kept block doubling, on a single block holding the
+    frame that used the most memory. `high_water` keeps the most bytes the
+    arena held at once.
+
     ## miscelaneous
 
     - ARRAYSIZE(array)
@@ -51,6 +85,12 @@
 #include <stdint.h>
 #include <string.h>
 #include <assert.h>
+#include <stdbool.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define DA_USE_MMAP
+#include <sys/mman.h>
+#endif
 
 #define ARRAYSIZE(array) sizeof(array) / sizeof(*(array))
 #define internal static
@@ -79,13 +119,18 @@ typedef struct Dynamic_Array_Header {
  *
  */
 #define DA_INITIAL_CAP 8
+#define DA_MMAP_BYTES ((size_t)32 << 20)
 #define LIBC_ALLOCATED 0x673e82d2 // echo -n realocate_stretch_array | md5sum
+#define DA_EXTERNAL 0x4b001c53    // echo -n da_external_memory | md5sum
+#define DA_MMAPPED 0x1e3cfa4d     // echo -n da_mmap_array | md5sum
 
 #define _DA_HDR(da) ((Dynamic_Array_Header*)((uintptr_t)(da) -                \
         sizeof(Dynamic_Array_Header)))
 
 #define da_size(da) (*(((da))?&(_DA_HDR((da))->size) : &DUMMY_SIZE_T))
 
+#define da_cap(da) (((da))? _DA_HDR((da))->cap : 0)
+
 #define da_end(da) ((da) + da_size(da))
 
 #define da_append(da, x)                                                      \
@@ -110,12 +155,7 @@ typedef struct Dynamic_Array_Header {
 
 #define da_free(da)                                                           \
     do {                                                                      \
-        if (da) {                                                             \
-            assert(_DA_HDR(da)->flags == LIBC_ALLOCATED &&                    \
-                "this dynamic array was not allocated with"                   \
-                "`realocate_stretch_array`") ;                                \
-            free(_DA_HDR(da));                                                \
-        }                                                                     \
+        if (da) da_release((da), sizeof(*(da)));                              \
         (da) = NULL;                                                          \
     } while(0)
 
@@ -129,6 +169,28 @@ typedef struct Dynamic_Array_Header {
         da_size(da) += num_items;                                             \
     } while(0)
 
+#define da_reserve(da, num_items)                                             \
+    do {                                                                      \
+        if((da) == NULL || da_size(da) + (num_items) > _DA_HDR(da)->cap) {    \
+            (da) = realocate_stretch_array((da), da_size(da) + (num_items),   \
+                    sizeof(*(da)));                                           \
+        }                                                                     \
+    } while(0)
+
+#define da_resize(da, num_items)                                              \
+    do {                                                                      \
+        size_t macro_n = (num_items);                                         \
+        if (macro_n > da_cap(da)) {                                           \
+            (da) = realocate_stretch_array((da), macro_n, sizeof(*(da)));     \
+        }                                                                     \
+        if (da) _DA_HDR(da)->size = macro_n;                                  \
+    } while(0)
+
+#define da_shrink_to_fit(da)                                                  \
+    do {                                                                      \
+        if (da) (da) = da_shrink((da), sizeof(*(da)));                        \
+    } while(0)
+
 #define arena_da_append_many(arena, da, items, num_items)                     \
     do {                                                                      \
         if((da) == NULL || da_size(da) + num_items > _DA_HDR(da)->cap) {      \
@@ -139,6 +201,14 @@ typedef struct Dynamic_Array_Header {
         _DA_HDR(da)->size += num_items;                                       \
     } while(0)
 
+#define arena_da_reserve(arena, da, num_items)                                \
+    do {                                                                      \
+        if((da) == NULL || da_size(da) + (num_items) > _DA_HDR(da)->cap) {    \
+            (da) = arena_da_realoc((arena), (da), da_size(da) + (num_items),  \
+                    sizeof(*(da)));                                           \
+        }                                                                     \
+    } while(0)
+
 #define sb_append_cstr(sb, str)                                               \
     do {                                                                      \
         assert(sizeof(*(sb)) == 1);                                           \
@@ -154,11 +224,27 @@ typedef struct Dynamic_Array_Header {
     } while(0)
 
 
+//
+// Bitset
+//
+
+#define BITSET_WORDS(num_bits) (((size_t)(num_bits) + 63)/64)
+#define bitset_get(bits, i) (((bits)[(i) >> 6] >> ((i) & 63)) & 1)
+#define bitset_set(bits, i) ((bits)[(i) >> 6] |= (uint64_t)1 << ((i) & 63))
+#define bitset_unset(bits, i) ((bits)[(i) >> 6] &= ~((uint64_t)1 << ((i) & 63)))
+
+/* first bit set at or after `from`, -1 when there is none
+ *
+ *     for (int i = bitset_next(bits, n, 0); i >= 0; i = bitset_next(bits, n, i + 1))
+ */
+int bitset_next(const uint64_t *bits, size_t num_words, int from);
+
 //
 // Arena
 //
 
 #define BLOCK_SIZE (4*1024)
+#define ARENA_MAX_GROWTH ((size_t)64 << 20)    // largest block made by growth alone
 
 typedef struct Block Block;
 struct Block{
@@ -170,15 +256,18 @@ struct Block{
 typedef struct Arena Arena;
 struct Arena {
     Block *begin;
-    Block *end;
-    size_t size;
+    Block *end;             // the current block
+    size_t size;            // used in the current block
     int allign;
+    size_t base;            // bytes used in the blocks before the current one
+    size_t high_water;      // most bytes used at once
 };
 
 typedef struct Arena_Mark Arena_Mark;
 struct Arena_Mark {
     Block *block;
     size_t size;
+    size_t base;
 };
 
 void * arena_push_size(Arena *a, size_t size);
@@ -192,6 +281,10 @@ if allign is zero mean no allignment.
 */
 void   arena_set_allign(Arena *a, int allign);
 
+/* bytes used, from the start of the first block to the last allocation.
+*/
+size_t arena_used(Arena *a);
+
 /* print information about the curent internal state of allocator.
 */
 void   arena_status(Arena *a);
@@ -203,13 +296,16 @@ void   arena_status(Arena *a);
 #undef COMMONS_IMPLEMENTATION
 // global_variable const size_t stub_size = 0;
 
-internal Block *new_block(size_t desired)
+// a block for `desired` bytes, and at least `min_capacity`
+internal Block *new_block(size_t desired, size_t min_capacity)
 {
+    if (desired < min_capacity) desired = min_capacity;
     size_t to_allocate = desired + sizeof(Block);
     size_t num_blocks = (to_allocate + BLOCK_SIZE - 1) / BLOCK_SIZE;
     to_allocate = num_blocks*BLOCK_SIZE;
 
     Block *result = (Block *)malloc(to_allocate);
+    assert(result);
 
     result->capacity = to_allocate - sizeof(Block);
     result->next = NULL;
@@ -217,29 +313,34 @@ internal Block *new_block(size_t desired)
     return result;
 }
 
-void * arena_push_size(Arena *a, size_t size)
+internal void *arena_push_slow(Arena *a, size_t size)
 {
-    static_assert(sizeof(Block) % 8 == 0);
     int allign = (a->allign)? a->allign : 1;
 
     if(a->end == NULL) {
         assert(a->begin == NULL);
-        Block *b = new_block(size);
+        Block *b = new_block(size, 0);
         a->begin = b;
         a->end = b;
         a->size = 0;
+        a->base = 0;
     }
 
     size_t offset = ((a->size + allign -1) / allign) * allign;
 
     while(offset + size > a->end->capacity && a->end->next != NULL) {
+        a->base += a->size;
         a->end = a->end->next;
+        a->size = 0;
         offset = 0;
     }
 
     if(offset + size > a->end->capacity) {
         assert(a->end->next == NULL);
-        Block *b = new_block(size);
+        size_t growth = 2*a->end->capacity;
+        if (growth > ARENA_MAX_GROWTH) growth = ARENA_MAX_GROWTH;
+        Block *b = new_block(size, growth);
+        a->base += a->size;
         a->end->next = b;
         a->end = b;
         a->size = 0;
@@ -248,14 +349,43 @@ void * arena_push_size(Arena *a, size_t size)
 
     void *result = a->end->data + offset;
     a->size = offset + size;
+    if (a->base + a->size > a->high_water) a->high_water = a->base + a->size;
 
     return result;
 }
 
+void * arena_push_size(Arena *a, size_t size)
+{
+    static_assert(sizeof(Block) % 8 == 0);
+    int allign = (a->allign)? a->allign : 1;
+
+    size_t offset = ((a->size + allign -1) / allign) * allign;
+    if (a->end && offset + size <= a->end->capacity) {
+        a->size = offset + size;
+        if (a->base + a->size > a->high_water) a->high_water = a->base + a->size;
+        return a->end->data + offset;
+    }
+    return arena_push_slow(a, size);
+}
+
 void   arena_reset(Arena *a)
 {
+    if (a->begin && a->begin->next) {
+        Block *largest = a->begin;
+        for (Block *p = a->begin->next; p != NULL; p = p->next)
+            if (p->capacity > largest->capacity) largest = p;
+        Block *p = a->begin;
+        while (p != NULL) {
+            Block *next = p->next;
+            if (p != largest) free(p);
+            p = next;
+        }
+        largest->next = NULL;
+        a->begin = largest;
+    }
     a->end = a->begin;
     a->size = 0;
+    a->base = 0;
 }
 
 void   arena_free(Arena *a)
@@ -269,12 +399,14 @@ void   arena_free(Arena *a)
     }
     a->begin = NULL;
     a->end   = NULL;
+    a->size  = 0;
+    a->base  = 0;
 }
 
 Arena_Mark arena_snapshot(Arena *a)
 {
 
-    Arena_Mark result = {a->end, a->size};
+    Arena_Mark result = {a->end, a->size, a->base};
     return result;
 }
 
@@ -285,6 +417,7 @@ void   arena_rewind(Arena *a, Arena_Mark m)
     else
         a->end = m.block;
     a->size = m.size;
+    a->base = m.base;
 }
 
 void   arena_set_allign(Arena *a, int allign)
@@ -294,6 +427,11 @@ void   arena_set_allign(Arena *a, int allign)
     a->allign = allign;
 }
 
+size_t arena_used(Arena *a)
+{
+    return a->base + a->size;
+}
+
 void   arena_status(Arena *a)
 {
     size_t num_blocks = 0;
@@ -317,43 +455,153 @@ void   arena_status(Arena *a)
                 a->size, a->end->capacity);
     }
     printf("total capacity: %zu\n", total_capacity);
+    printf("used: %zu\n", arena_used(a));
+    printf("high water mark: %zu\n", a->high_water);
     printf("\n");
 
 }
 
 
-internal void *realocate_stretch_array(void *array, uint32_t desired,
-        uint32_t item_size)
+int bitset_next(const uint64_t *bits, size_t num_words, int from)
+{
+    size_t w = (size_t)from >> 6;
+    if (w >= num_words) return -1;
+    uint64_t word = bits[w] & (~(uint64_t)0 << (from & 63));
+    while (word == 0) {
+        if (++w == num_words) return -1;
+        word = bits[w];
+    }
+    return (int)(w*64 + __builtin_ctzll(word));
+}
+
+// bytes of the allocation of an array with `cap` items
+internal size_t da_alloc_bytes(size_t cap, size_t item_size)
+{
+    assert(cap <= (SIZE_MAX - sizeof(Dynamic_Array_Header))/item_size &&
+            "dynamic array too large");
+    return cap*item_size + sizeof(Dynamic_Array_Header);
+}
+
+#ifdef DA_USE_MMAP
+internal void *da_map(size_t bytes)
 {
-    uint32_t new_cap = DA_INITIAL_CAP;
-    uint32_t cap = ((array)? _DA_HDR(array)->cap : 0);
-    if (new_cap < cap) new_cap = cap;
+    void *base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+    madvise(base, bytes, MADV_HUGEPAGE);
+#endif
+    return base;
+}
 
-    while (new_cap < desired) {
-        new_cap = 2*new_cap;
+// move the mapping of `old_bytes` at `base` to one of `bytes`, the content is kept
+internal void *da_remap(void *base, size_t old_bytes, size_t bytes)
+{
+#ifdef MREMAP_MAYMOVE
+    void *result = mremap(base, old_bytes, bytes, MREMAP_MAYMOVE);
+    if (result == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+    if (bytes > old_bytes) madvise(result, bytes, MADV_HUGEPAGE);
+#endif
+    return result;
+#else
+    void *result = da_map(bytes);
+    if (!result) return NULL;
+    memcpy(result, base, (old_bytes < bytes)? old_bytes : bytes);
+    munmap(base, old_bytes);
+    return result;
+#endif
+}
+#endif
+
+// free the memory of an array, see da_free()
+internal void da_release(void *array, size_t item_size)
+{
+    Dynamic_Array_Header *hdr = _DA_HDR(array);
+    switch (hdr->flags) {
+    case DA_EXTERNAL:
+        break;
+#ifdef DA_USE_MMAP
+    case DA_MMAPPED:
+        munmap(hdr, da_alloc_bytes(hdr->cap, item_size));
+        break;
+#endif
+    default:
+        assert(hdr->flags == LIBC_ALLOCATED && "this dynamic array was not allocated with"
+                "`realocate_stretch_array`");
+        free(hdr);
     }
+}
 
-    void *base;
-    uint32_t new_size_in_bytes = new_cap * item_size + sizeof(Dynamic_Array_Header);
-    if(array) {
-        assert(_DA_HDR(array)->flags == LIBC_ALLOCATED &&
-                "this dynamic array was not allocated with `realocate_stretch_array`");
-        base = realloc(_DA_HDR(array), new_size_in_bytes);
-        // array_log("realocating %d bytes\n", new_size_in_bytes);
+// move the array to an allocation for `new_cap` items, keeping the items that
+// fit. the allocation is a memory mapping from DA_MMAP_BYTES on
+internal void *da_move(void *array, size_t new_cap, size_t item_size)
+{
+    size_t new_bytes = da_alloc_bytes(new_cap, item_size);
+    Dynamic_Array_Header *hdr = (array)? _DA_HDR(array) : NULL;
+    size_t flags = (hdr)? hdr->flags : LIBC_ALLOCATED;
+    assert((flags == LIBC_ALLOCATED || flags == DA_EXTERNAL || flags == DA_MMAPPED) &&
+            "this dynamic array was not allocated with `realocate_stretch_array`");
+
+    bool mapped = false;
+#ifdef DA_USE_MMAP
+    mapped = new_bytes >= DA_MMAP_BYTES;
+#endif
+    void *base = NULL;
+    if (hdr && flags == LIBC_ALLOCATED && !mapped) {
+        base = realloc(hdr, new_bytes);
+        // array_log("realocating %zu bytes\n", new_bytes);
+#ifdef DA_USE_MMAP
+    } else if (hdr && flags == DA_MMAPPED && mapped) {
+        base = da_remap(hdr, da_alloc_bytes(hdr->cap, item_size), new_bytes);
+#endif
     } else {
-        base = realloc(NULL, new_size_in_bytes);
-        *((Dynamic_Array_Header *)base) = (Dynamic_Array_Header){.flags = LIBC_ALLOCATED};
-        // array_log("initial allocation with %d bytes\n", new_size_in_bytes);
+        // a new allocation, the items are copied from the old one
+#ifdef DA_USE_MMAP
+        base = (mapped)? da_map(new_bytes) : malloc(new_bytes);
+#else
+        base = malloc(new_bytes);
+#endif
+        assert(base);
+        *((Dynamic_Array_Header *)base) = (Dynamic_Array_Header){0};
+        if (hdr) {
+            size_t size = (hdr->size < new_cap)? hdr->size : new_cap;
+            memcpy(base, hdr, size*item_size + sizeof(*hdr));
+            da_release(array, item_size);
+        }
+        // array_log("allocation with %zu bytes\n", new_bytes);
     }
     assert(base);
 
     void *new_array = (uint8_t *)base + sizeof(Dynamic_Array_Header);
-
     _DA_HDR(new_array)->cap = new_cap;
-
+    _DA_HDR(new_array)->flags = (mapped)? DA_MMAPPED : LIBC_ALLOCATED;
+    if (_DA_HDR(new_array)->size > new_cap) _DA_HDR(new_array)->size = new_cap;
     return new_array;
 }
 
+// grow the array to hold at least `desired` items, doubling its capacity
+internal void *realocate_stretch_array(void *array, size_t desired, size_t item_size)
+{
+    size_t new_cap = DA_INITIAL_CAP;
+    size_t cap = ((array)? _DA_HDR(array)->cap : 0);
+    if (new_cap < 2*cap) new_cap = 2*cap;
+    if (new_cap < desired) new_cap = desired;
+    return da_move(array, new_cap, item_size);
+}
+
+// the array with its capacity down to its size, see da_shrink_to_fit(). arrays
+// in external memory are left where they are
+internal void *da_shrink(void *array, size_t item_size)
+{
+    Dynamic_Array_Header *hdr = _DA_HDR(array);
+    if (hdr->flags == DA_EXTERNAL || hdr->cap == hdr->size) return array;
+    if (hdr->size == 0) {
+        da_release(array, item_size);
+        return NULL;
+    }
+    return da_move(array, hdr->size, item_size);
+}
+
 #define ARENA_ALLOCATED 0x38fb1cf2 // echo -n arena_da_realoc | md5sum
 internal void *arena_da_realoc(Arena *a, void *array, size_t desired, size_t item_size)
 {
@@ -363,14 +611,13 @@ internal void *arena_da_realoc(Arena *a, void *array, size_t desired, size_t ite
     while(new_cap < desired ) new_cap = 2*new_cap;
 
     void *base;
-    uint32_t new_size_in_bytes = new_cap * item_size +
-            sizeof(Dynamic_Array_Header);
+    size_t new_size_in_bytes = da_alloc_bytes(new_cap, item_size);
     if(array) {
         assert(_DA_HDR(array)->flags == ARENA_ALLOCATED && "this dynamic "
                 "array was not allocated with `arena_da_realoc`");
         arena_set_allign(a, 8);
         base = arena_push_size(a, new_size_in_bytes);
-        memcpy(base, _DA_HDR(array), _DA_HDR(array)->cap * item_size +
+        memcpy(base, _DA_HDR(array), _DA_HDR(array)->size * item_size +
                 sizeof(Dynamic_Array_Header));
     } else {
         arena_set_allign(a, 8);
@@ -0,0 +1,141 @@
+// Edge geometry cache with dirty tracking
+//
+// every edge carries a version stamp, bumped each time it or one of its nodes is
+// moved or edited. `geo_version[e]` remembers the stamp edge `e` had when its EdgeGeo was
+// computed, so the geometry is stale whenever it is behind `edge_version[e]`.
+// moving a node stamps all the edges incident to it, found in the Adjacency
+// index, and queues them on `dirty`; `geo_cache_update()` only recomputes
+// those, split in jobs of GEO_JOB_GRAIN edges over the job pool, GEO_LANES
+// edges at a time with the SIMD kernel of geosimd.c.
+//
+// a removed edge is dropped from `dirty` by the next update, and touched again
+// when its slot is reused.
+
+#define GEO_JOB_GRAIN 2048
+
+typedef struct GeoCache {
+    uint32_t version;
+    uint32_t *edge_version;
+    uint32_t *geo_version;
+    int *dirty;         // edges queued for recomputation
+    int *updated;       // edges recomputed by the last update
+    EdgeGeo *geo;
+    int rebuilt;        // number of edges recomputed by the last update
+} GeoCache;
+
+void geo_cache_touch_edge(GeoCache *gc, int edge)
+{
+    if (gc->geo_version[edge] == gc->edge_version[edge])
+        da_append(gc->dirty, edge);
+    gc->edge_version[edge] = ++gc->version;
+}
+
+void geo_cache_touch_node(GeoCache *gc, Adjacency *adj, int node)
+{
+    gc->version++;      // the node is drawn elsewhere even without edges
+    for (int dir = 0; dir < 2; dir++) {
+        for (AdjCursor c = adjacency_begin(adj, dir, node); adjacency_next(adj, dir, node, &c); )
+            geo_cache_touch_edge(gc, c.e);
+    }
+}
+
+void geo_cache_add_edge(GeoCache *gc)
+{
+    int id = da_size(gc->edge_version);
+    da_append(gc->edge_version, 0);
+    da_append(gc->geo_version, 0);
+    da_append(gc->geo, (EdgeGeo){0});
+    geo_cache_touch_edge(gc, id);
+}
+
+typedef struct GeoJob {
+    GeoCache *gc;
+    Graph *g;
+} GeoJob;
+
+// dirty[begin] to dirty[end - 1], an edge is queued once so the jobs write
+// disjoint entries
+internal void geo_cache_update_range(void *data, int begin, int end)
+{
+    GeoJob *job = data;
+    GeoCache *gc = job->gc;
+    Graph *g = job->g;
+    enum GeoSimd simd = geo_simd_best();
+    EdgeGeoLanes lanes;
+    int i = begin;
+    // without SIMD the loop below computes every edge
+    for (; simd != GEO_SCALAR && i + GEO_LANES <= end; i += GEO_LANES) {
+        for (int k = 0; k < GEO_LANES; k++) {
+            int id = gc->dirty[i + k];
+            int from = g->from[id];
+            int to = g->to[id];
+            Vector2 lsize = label_measured(&g->labels, g->label[id]);
+            lanes.n1x[k] = g->x[from];
+            lanes.n1y[k] = g->y[from];
+            lanes.n2x[k] = g->x[to];
+            lanes.n2y[k] = g->y[to];
+            lanes.c1x[k] = g->ctrl[0][id].x;
+            lanes.c1y[k] = g->ctrl[0][id].y;
+            lanes.c2x[k] = g->ctrl[1][id].x;
+            lanes.c2y[k] = g->ctrl[1][id].y;
+            lanes.lox[k] = g->loffset[id].x;
+            lanes.loy[k] = g->loffset[id].y;
+            lanes.lw[k] = lsize.x;
+            lanes.lh[k] = lsize.y;
+        }
+        compute_edge_geo_lanes(&lanes, simd);
+        for (int k = 0; k < GEO_LANES; k++) {
+            int id = gc->dirty[i + k];
+            edge_geo_lanes_get(&lanes, k, gc->geo + id);
+            gc->geo_version[id] = gc->edge_version[id];
+        }
+    }
+
+    for (; i < end; i++) {
+        int id = gc->dirty[i];
+        Vector2 lsize = label_measured(&g->labels, g->label[id]);
+        compute_edge_geo(gc->geo + id, graph_node_pos(g, g->from[id]), graph_node_pos(g, g->to[id]),
+                g->ctrl[0][id], g->ctrl[1][id], g->loffset[id], lsize);
+        gc->geo_version[id] = gc->edge_version[id];
+    }
+}
+
+// recompute the geometry of all dirty edges. returns the number of edges rebuilt,
+// their ids are left in `updated` until the next call
+int geo_cache_update(GeoCache *gc, Graph *g, GraphCtx *ctx)
+{
+    // drop the edges removed since they were queued, and fill the label size
+    // cache here: label_measure() writes the entries, shared by the edges with
+    // the same label, and the jobs only read them with label_measured()
+    size_t n = 0;
+    for (size_t i = 0; i < da_size(gc->dirty); i++) {
+        int id = gc->dirty[i];
+        if (!graph_edge_alive(g, id)) {
+            gc->geo_version[id] = gc->edge_version[id];
+            continue;
+        }
+        gc->dirty[n++] = id;
+        label_measure(&g->labels, g->label[id], ctx->font, UI_FONT_SIZE, LABEL_SPACING);
+    }
+    da_size(gc->dirty) = n;
+    GeoJob job = {gc, g};
+    job_parallel_for(&global_jobs, da_size(gc->dirty), GEO_JOB_GRAIN, geo_cache_update_range, &job);
+    gc->rebuilt = da_size(gc->dirty);
+
+    int *tmp = gc->updated;
+    gc->updated = gc->dirty;
+    gc->dirty = tmp;
+    da_size(gc->dirty) = 0;
+
+    return gc->rebuilt;
+}
+
+void geo_cache_free(GeoCache *gc)
+{
+    da_free(gc->edge_version);
+    da_free(gc->geo_version);
+    da_free(gc->dirty);
+    da_free(gc->updated);
+    da_free(gc->geo);
+    *gc = (GeoCache){0};
+}
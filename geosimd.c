@@ -0,0 +1,219 @@
+// Batched edge geometry
+//
+// compute_edge_geo() for GEO_LANES edges at once, on inputs in structure of
+// arrays form, one edge per SIMD lane: AVX (8 lanes) when the CPU has it, SSE
+// (twice 4 lanes) on any x86-64. elsewhere geo_simd_best() is GEO_SCALAR and the
+// callers call compute_edge_geo() per edge: filling and reading back the lanes
+// only pays off when the lanes are computed together. the operations are those
+// of the scalar function in the same order, and sqrt and division are exact in
+// all of them, so the results are the same as compute_edge_geo()'s up to the
+// contraction of multiply-adds by the compiler.
+//
+// AVX measures within the noise of SSE in bench --geo: both kernels fill and
+// read back the same lanes, and those copies cost as much as the arithmetic.
+//
+// the label anchor is the point of the curve at t = 0.5, where the Bernstein
+// weights of GetSplinePointBezierCubic() are 1/8, 3/8, 3/8, 1/8.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define GEO_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#define GEO_LANES 8
+
+enum GeoSimd {
+    GEO_SCALAR,
+    GEO_SSE,
+    GEO_AVX,
+};
+
+typedef struct EdgeGeoLanes {
+    // input
+    float n1x[GEO_LANES], n1y[GEO_LANES];     // nodes
+    float n2x[GEO_LANES], n2y[GEO_LANES];
+    float c1x[GEO_LANES], c1y[GEO_LANES];     // control points, relative to the nodes
+    float c2x[GEO_LANES], c2y[GEO_LANES];
+    float lox[GEO_LANES], loy[GEO_LANES];     // label offset
+    float lw[GEO_LANES], lh[GEO_LANES];       // label size
+
+    // output, EdgeGeo.points of every lane
+    float x[EI_BB_MAX + 1][GEO_LANES];
+    float y[EI_BB_MAX + 1][GEO_LANES];
+} EdgeGeoLanes;
+
+#ifdef GEO_SIMD_X86
+
+// lanes [k, k + 4)
+internal void edge_geo_lanes_sse(EdgeGeoLanes *l, int k)
+{
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 n1x = _mm_loadu_ps(l->n1x + k), n1y = _mm_loadu_ps(l->n1y + k);
+    __m128 n2x = _mm_loadu_ps(l->n2x + k), n2y = _mm_loadu_ps(l->n2y + k);
+    __m128 c1x = _mm_loadu_ps(l->c1x + k), c1y = _mm_loadu_ps(l->c1y + k);
+    __m128 c2x = _mm_loadu_ps(l->c2x + k), c2y = _mm_loadu_ps(l->c2y + k);
+
+    // Vector2Normalize(), 0 for null vectors
+    __m128 len1 = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(c1x, c1x), _mm_mul_ps(c1y, c1y)));
+    __m128 inv1 = _mm_and_ps(_mm_cmpgt_ps(len1, zero), _mm_div_ps(one, len1));
+    __m128 len2 = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(c2x, c2x), _mm_mul_ps(c2y, c2y)));
+    __m128 inv2 = _mm_and_ps(_mm_cmpgt_ps(len2, zero), _mm_div_ps(one, len2));
+    __m128 u1x = _mm_mul_ps(c1x, inv1), u1y = _mm_mul_ps(c1y, inv1);
+    __m128 u2x = _mm_mul_ps(c2x, inv2), u2y = _mm_mul_ps(c2y, inv2);
+
+    __m128 radius = _mm_set1_ps(NODE_RADIUS);
+    __m128 arrow = _mm_set1_ps(NODE_RADIUS + ARROW_LEN);
+    __m128 p[EI_BB_MAX + 1][2];
+    p[EI_BS][0]  = _mm_add_ps(n1x, _mm_mul_ps(u1x, radius));
+    p[EI_BS][1]  = _mm_add_ps(n1y, _mm_mul_ps(u1y, radius));
+    p[EI_BE][0]  = _mm_add_ps(n2x, _mm_mul_ps(u2x, arrow));
+    p[EI_BE][1]  = _mm_add_ps(n2y, _mm_mul_ps(u2y, arrow));
+    p[EI_C1A][0] = _mm_add_ps(n1x, c1x);
+    p[EI_C1A][1] = _mm_add_ps(n1y, c1y);
+    p[EI_C2A][0] = _mm_add_ps(n2x, c2x);
+    p[EI_C2A][1] = _mm_add_ps(n2y, c2y);
+
+    __m128 w0 = _mm_set1_ps(0.125f);
+    __m128 w1 = _mm_set1_ps(0.375f);
+    for (int c = 0; c < 2; c++) {
+        __m128 b = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, p[EI_BS][c]),
+                        _mm_mul_ps(w1, p[EI_C1A][c])), _mm_mul_ps(w1, p[EI_C2A][c])),
+                _mm_mul_ps(w0, p[EI_BE][c]));
+        p[EI_LPOS][c] = _mm_add_ps(b, _mm_loadu_ps(((c == 0)? l->lox : l->loy) + k));
+    }
+    p[EI_LSIZE][0] = _mm_loadu_ps(l->lw + k);
+    p[EI_LSIZE][1] = _mm_loadu_ps(l->lh + k);
+
+    __m128 half_base = _mm_set1_ps(ARROW_HALF_BASE);
+    __m128 t1x = _mm_mul_ps(_mm_sub_ps(zero, u2y), half_base);
+    __m128 t1y = _mm_mul_ps(u2x, half_base);
+    p[EI_TIP][0] = _mm_add_ps(n2x, _mm_mul_ps(u2x, radius));
+    p[EI_TIP][1] = _mm_add_ps(n2y, _mm_mul_ps(u2y, radius));
+    p[EI_B2][0]  = _mm_sub_ps(p[EI_BE][0], t1x);
+    p[EI_B2][1]  = _mm_sub_ps(p[EI_BE][1], t1y);
+    p[EI_B1][0]  = _mm_add_ps(p[EI_BE][0], t1x);
+    p[EI_B1][1]  = _mm_add_ps(p[EI_BE][1], t1y);
+
+    __m128 half_thick = _mm_set1_ps(EDGE_THICKNESS/2);
+    for (int c = 0; c < 2; c++) {
+        __m128 bbmin = _mm_add_ps(p[EI_LPOS][c], p[EI_LSIZE][c]);
+        __m128 bbmax = bbmin;
+        for (int i = EI_BS; i <= EI_LPOS; i++) {
+            bbmin = _mm_min_ps(bbmin, p[i][c]);
+            bbmax = _mm_max_ps(bbmax, p[i][c]);
+        }
+        p[EI_BB_MIN][c] = _mm_sub_ps(bbmin, half_thick);
+        p[EI_BB_MAX][c] = _mm_add_ps(bbmax, half_thick);
+    }
+
+    for (int i = 0; i <= EI_BB_MAX; i++) {
+        _mm_storeu_ps(l->x[i] + k, p[i][0]);
+        _mm_storeu_ps(l->y[i] + k, p[i][1]);
+    }
+}
+
+__attribute__((target("avx")))
+internal void edge_geo_lanes_avx(EdgeGeoLanes *l)
+{
+    __m256 zero = _mm256_setzero_ps();
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 n1x = _mm256_loadu_ps(l->n1x), n1y = _mm256_loadu_ps(l->n1y);
+    __m256 n2x = _mm256_loadu_ps(l->n2x), n2y = _mm256_loadu_ps(l->n2y);
+    __m256 c1x = _mm256_loadu_ps(l->c1x), c1y = _mm256_loadu_ps(l->c1y);
+    __m256 c2x = _mm256_loadu_ps(l->c2x), c2y = _mm256_loadu_ps(l->c2y);
+
+    // Vector2Normalize(), 0 for null vectors
+    __m256 len1 = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(c1x, c1x), _mm256_mul_ps(c1y, c1y)));
+    __m256 inv1 = _mm256_and_ps(_mm256_cmp_ps(len1, zero, _CMP_GT_OQ), _mm256_div_ps(one, len1));
+    __m256 len2 = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(c2x, c2x), _mm256_mul_ps(c2y, c2y)));
+    __m256 inv2 = _mm256_and_ps(_mm256_cmp_ps(len2, zero, _CMP_GT_OQ), _mm256_div_ps(one, len2));
+    __m256 u1x = _mm256_mul_ps(c1x, inv1), u1y = _mm256_mul_ps(c1y, inv1);
+    __m256 u2x = _mm256_mul_ps(c2x, inv2), u2y = _mm256_mul_ps(c2y, inv2);
+
+    __m256 radius = _mm256_set1_ps(NODE_RADIUS);
+    __m256 arrow = _mm256_set1_ps(NODE_RADIUS + ARROW_LEN);
+    __m256 p[EI_BB_MAX + 1][2];
+    p[EI_BS][0]  = _mm256_add_ps(n1x, _mm256_mul_ps(u1x, radius));
+    p[EI_BS][1]  = _mm256_add_ps(n1y, _mm256_mul_ps(u1y, radius));
+    p[EI_BE][0]  = _mm256_add_ps(n2x, _mm256_mul_ps(u2x, arrow));
+    p[EI_BE][1]  = _mm256_add_ps(n2y, _mm256_mul_ps(u2y, arrow));
+    p[EI_C1A][0] = _mm256_add_ps(n1x, c1x);
+    p[EI_C1A][1] = _mm256_add_ps(n1y, c1y);
+    p[EI_C2A][0] = _mm256_add_ps(n2x, c2x);
+    p[EI_C2A][1] = _mm256_add_ps(n2y, c2y);
+
+    __m256 w0 = _mm256_set1_ps(0.125f);
+    __m256 w1 = _mm256_set1_ps(0.375f);
+    for (int c = 0; c < 2; c++) {
+        __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(w0, p[EI_BS][c]),
+                        _mm256_mul_ps(w1, p[EI_C1A][c])), _mm256_mul_ps(w1, p[EI_C2A][c])),
+                _mm256_mul_ps(w0, p[EI_BE][c]));
+        p[EI_LPOS][c] = _mm256_add_ps(b, _mm256_loadu_ps((c == 0)? l->lox : l->loy));
+    }
+    p[EI_LSIZE][0] = _mm256_loadu_ps(l->lw);
+    p[EI_LSIZE][1] = _mm256_loadu_ps(l->lh);
+
+    __m256 half_base = _mm256_set1_ps(ARROW_HALF_BASE);
+    __m256 t1x = _mm256_mul_ps(_mm256_sub_ps(zero, u2y), half_base);
+    __m256 t1y = _mm256_mul_ps(u2x, half_base);
+    p[EI_TIP][0] = _mm256_add_ps(n2x, _mm256_mul_ps(u2x, radius));
+    p[EI_TIP][1] = _mm256_add_ps(n2y, _mm256_mul_ps(u2y, radius));
+    p[EI_B2][0]  = _mm256_sub_ps(p[EI_BE][0], t1x);
+    p[EI_B2][1]  = _mm256_sub_ps(p[EI_BE][1], t1y);
+    p[EI_B1][0]  = _mm256_add_ps(p[EI_BE][0], t1x);
+    p[EI_B1][1]  = _mm256_add_ps(p[EI_BE][1], t1y);
+
+    __m256 half_thick = _mm256_set1_ps(EDGE_THICKNESS/2);
+    for (int c = 0; c < 2; c++) {
+        __m256 bbmin = _mm256_add_ps(p[EI_LPOS][c], p[EI_LSIZE][c]);
+        __m256 bbmax = bbmin;
+        for (int i = EI_BS; i <= EI_LPOS; i++) {
+            bbmin = _mm256_min_ps(bbmin, p[i][c]);
+            bbmax = _mm256_max_ps(bbmax, p[i][c]);
+        }
+        p[EI_BB_MIN][c] = _mm256_sub_ps(bbmin, half_thick);
+        p[EI_BB_MAX][c] = _mm256_add_ps(bbmax, half_thick);
+    }
+
+    for (int i = 0; i <= EI_BB_MAX; i++) {
+        _mm256_storeu_ps(l->x[i], p[i][0]);
+        _mm256_storeu_ps(l->y[i], p[i][1]);
+    }
+}
+
+#endif // GEO_SIMD_X86
+
+// the widest kernel the CPU runs
+enum GeoSimd geo_simd_best(void)
+{
+#ifdef GEO_SIMD_X86
+    return (__builtin_cpu_supports("avx"))? GEO_AVX : GEO_SSE;
+#else
+    return GEO_SCALAR;
+#endif
+}
+
+// the geometry of the GEO_LANES edges of `l`, with the kernel `simd`, GEO_SSE
+// or GEO_AVX
+void compute_edge_geo_lanes(EdgeGeoLanes *l, enum GeoSimd simd)
+{
+    assert(simd != GEO_SCALAR);
+#ifdef GEO_SIMD_X86
+    if (simd == GEO_AVX) {
+        edge_geo_lanes_avx(l);
+    } else {
+        edge_geo_lanes_sse(l, 0);
+        edge_geo_lanes_sse(l, 4);
+    }
+#else
+    (void)l;
+#endif
+}
+
+// copy lane `i` of the output to `geo`
+inline internal void edge_geo_lanes_get(EdgeGeoLanes *l, int i, EdgeGeo *geo)
+{
+    for (int p = 0; p <= EI_BB_MAX; p++)
+        geo->points[p] = (Vector2){l->x[p][i], l->y[p][i]};
+}
@@ -1,5 +1,8 @@
+#define _GNU_SOURCE // mremap() for the large dynamic arrays, see commons.h
+
 #include "raylib.h"
 #include "raymath.h"
+#include "rlgl.h"
 #include <stddef.h>
 #include <assert.h>
 #include <string.h>
@@ -22,35 +25,69 @@
 #define ORIGIN_COLOR CLITERAL(Color){255,255,255,255}
 #define HOVER_MARGIN 10
 #define CONTROL_RADIUS 6
+#define MIN_ZOOM 0.01f          // nodes are less than a pixel wide, see lod_node()
+#define MAX_ZOOM 800.0f
+#define CURVE_PICK_MARGIN 4     // pixels around an edge curve that pick it
 #define MIN_CONTROL_DISTANCE 60
 #define ARROW_HALF_BASE 8
 #define ARROW_LEN 20
+#define EDGE_THICKNESS 4.0f
 #define UI_FONT_SIZE 25.0f
+#define LABEL_SPACING 2.0f
 #define BORDER_COLOR CLITERAL(Color){40,40,40,255}
-
-typedef struct Edge {
-    int from;
-    int to;
-    Vector2 ctrl[2];
-    Vector2 loffset;
-    char label[16]; // TODO: make it resizeable
-} Edge;
+#define PROF_TRACE_FILE "graphgui_trace.json"
+#define DEFAULT_GRAPH_FILE "graph.grph"
+#define LOAD_FRAME_BUDGET_MS 10.0
+#define LAYOUT_FRAME_BUDGET_MS 10.0
+#define CULL_BLOCK 4096     // edges culled per job
+#define COMPACT_MIN_FREE 4096   // free slots left by removals before compacting
+
+// an item of the graph held across frames, see graphstore.c: its id and the
+// generation of its slot
+typedef struct Handle {
+    int id;             // -1 for none
+    uint32_t gen;
+} Handle;
+
+#define HANDLE_NONE ((Handle){-1, 0})
 
 typedef struct GraphCtx {
     float  zoom_coef;
     Font font;
-    int focused;
-    int active;
+    Handle focused;         // of the kind of item `id_type`, see item_handle()
+    Handle active;
     int id_type;
     bool show_control_pts;
+    bool show_stats;
+    bool show_profile;
+    bool record_trace;
+    bool batched;
+    bool cached_layer;      // draw the graph through a Layer
+    // of the graph drawn, for edge_color()
+    Color *edge_colors;
+    uint64_t *selected_edges;
+    Color edge_override;    // color of all the edges drawn when not {0}
 } GraphCtx;
 
 // EdgeGeo
-// start, c1, c2, end, tip, b1, b2, lpos, lsize
+// start, c1, c2, end, tip, b1, b2, lpos, lsize, bbmin, bbmax
 typedef struct EdgeGeo {
-    Vector2 points[9];
+    Vector2 points[11];
 } EdgeGeo;
 
+typedef struct FrameStats {
+    int edges_rebuilt;
+    int nodes_drawn;
+    int nodes_culled;
+    int edges_drawn;
+    int edges_culled;
+    int nodes_selected;
+    int edges_selected;
+    size_t frame_bytes;         // used in the frame arena
+    size_t frame_high_water;
+    int layer_redraws;
+} FrameStats;
+
 // rotate a vector by a right angle in the counter-clockwise direction
 Vector2 Vector2CounterRight(Vector2 v)
 {
@@ -66,6 +103,11 @@ enum GraphColors {
     GC_CONTROL_SELECTED,
     GC_LABEL,
     GC_LABEL_BACKGROUND_HOVER,
+    GC_SELECTED,
+    GC_NODE_SELECTED_BACKGROUND,
+    GC_SELECTION_BAND,
+    GC_SELECTION_BAND_BORDER,
+    GC_NEIGHBOR,
 
     GC_NUM_ITEMS
 };
@@ -80,6 +122,8 @@ enum EdgeItems{
     EI_B2,
     EI_LPOS,
     EI_LSIZE,
+    EI_BB_MIN,
+    EI_BB_MAX,
 };
 
 enum IdType {
@@ -91,6 +135,8 @@ enum IdType {
     IT_DRAWING,
     IT_WINDOW,
     IT_PAN,
+    IT_BAND,
+    IT_NEW_EDGE,        // dragged from the node `active`
 
     IT_NONE = -1,
 };
@@ -100,6 +146,7 @@ enum ToolId {
     TI_ADD_NODE,
     TI_REM_NODE,
     TI_DEBUG,
+    TI_LAYOUT,
 };
 
 static Color global_graph_colors[] = {
@@ -111,15 +158,26 @@ static Color global_graph_colors[] = {
     [GC_CONTROL_SELECTED] = GREEN,
     [GC_LABEL] = LIGHTGRAY,
     [GC_LABEL_BACKGROUND_HOVER] = {255,255,255, 51},
+    [GC_SELECTED] = ORANGE,
+    [GC_NODE_SELECTED_BACKGROUND] = {255,161, 0, 102},
+    [GC_SELECTION_BAND] = {102,191,255, 40},
+    [GC_SELECTION_BAND_BORDER] = SKYBLUE,
+    [GC_NEIGHBOR] = PURPLE,
+};
+
+// the colors the Color button gives to the selection in turn, {0} is the color
+// of the theme
+global_variable Color global_palette[] = {
+    {0}, RED, ORANGE, GOLD, LIME, SKYBLUE, VIOLET, PINK,
 };
 
 static_assert(ARRAYSIZE(global_graph_colors) == GC_NUM_ITEMS);
 #define internal static
 
-#define focus(type, id)           \
-    do { if (ctx.active < 0) {    \
-        ctx.focused = id;         \
-        ctx.id_type = type;       \
+#define focus(ctx, type, h)             \
+    do { if ((ctx)->active.id < 0) {    \
+        (ctx)->focused = h;             \
+        (ctx)->id_type = type;          \
     } } while(0)
 
 internal Color graph_color(enum GraphColors c)
@@ -136,8 +194,34 @@ inline internal Rectangle label_rect(EdgeGeo *geo)
     return result;
 }
 
-void draw_node(Vector2 pos, bool hovering)
+// bounding box of everything drawn for the edge: the curve (inside the hull of
+// its control points), the arrow and the label
+inline internal Rectangle edge_bounds(EdgeGeo *geo)
 {
+    Vector2 bbmin = geo->points[EI_BB_MIN];
+    Vector2 bbmax = geo->points[EI_BB_MAX];
+    Rectangle result = {bbmin.x, bbmin.y, bbmax.x - bbmin.x, bbmax.y - bbmin.y};
+    return result;
+}
+
+inline internal Rectangle node_bounds(Vector2 pos)
+{
+    float r = NODE_RADIUS + ((NODE_BORDER > HOVER_MARGIN)? NODE_BORDER : HOVER_MARGIN);
+    Rectangle result = {pos.x - r, pos.y - r, 2*r, 2*r};
+    return result;
+}
+
+#include "lod.c"
+
+void draw_node(Vector2 pos, Color color, bool hovering, bool selected, GraphCtx *ctx)
+{
+    if (selected) {
+        Rectangle r1 = {pos.x - NODE_RADIUS - HOVER_MARGIN,
+                pos.y - NODE_RADIUS - HOVER_MARGIN,
+                2*(NODE_RADIUS + HOVER_MARGIN),
+                2*(NODE_RADIUS + HOVER_MARGIN) };
+        DrawRectangleRounded(r1, 0.3f, 5, graph_color(GC_NODE_SELECTED_BACKGROUND));
+    }
     if (hovering) {
         Rectangle r1 = {pos.x - NODE_RADIUS - HOVER_MARGIN,
                 pos.y - NODE_RADIUS - HOVER_MARGIN,
@@ -145,387 +229,1388 @@ void draw_node(Vector2 pos, bool hovering)
                 2*(NODE_RADIUS + HOVER_MARGIN) };
         DrawRectangleRounded(r1, 0.3f, 5, HOVER_COLOR);
     }
-    DrawRing(pos, NODE_RADIUS, NODE_RADIUS + NODE_BORDER, 0.0f, 360.0f, 0, graph_color(GC_NODE)); // Draw ring
+    float r = NODE_RADIUS + NODE_BORDER;
+    switch (lod_node(ctx->zoom_coef)) {
+    case NL_POINT:
+        // one pixel centered on the node
+        DrawRectangleV(Vector2SubtractValue(pos, ctx->zoom_coef/2),
+                (Vector2){ctx->zoom_coef, ctx->zoom_coef}, color);
+        break;
+    case NL_QUAD:
+        DrawRectangleRec((Rectangle){pos.x - r, pos.y - r, 2*r, 2*r}, color);
+        break;
+    case NL_RING:
+        DrawRing(pos, NODE_RADIUS, r, 0.0f, 360.0f, lod_ring_segments(ctx->zoom_coef),
+                color); // Draw ring
+        break;
+    }
 }
 
+Color edge_color(int id, GraphCtx *ctx);
 void draw_edge(EdgeGeo *geo, int id, const char *label, GraphCtx *ctx);
+void draw_edge_controls(EdgeGeo *geo, int id, GraphCtx *ctx);
+void draw_stats(FrameStats *stats, Vector2 bottom_left);
 void compute_edge_geo(EdgeGeo *geo, Vector2 n1, Vector2 n2, Vector2 c1, Vector2 c2,
-        Vector2 loffset, const char *label, GraphCtx *ctx);
+        Vector2 loffset, Vector2 lsize);
+void graph_file_unmap(void *mapped, size_t size);
+
+#include "labels.c"
+#include "graphstore.c"
+#include "graphfile.c"
+#include "adjacency.c"
+#include "job.c"
+#include "geosimd.c"
+#include "geocache.c"
+#include "spatial.c"
+#include "batch.c"
+#include "layer.c"
+#include "prof.c"
+#include "import.c"
+#include "loader.c"
+#include "layout.c"
+#include "hierarchy.c"
+#include "journal.c"
+#include "selection.c"
+
+// the handle of item `id` of kind `type` (IdType), just the id for the kinds
+// that aren't items of the graph
+internal Handle item_handle(Graph *g, int type, int id)
+{
+    switch (type) {
+    case IT_NODE:
+    case IT_NEW_EDGE:
+        return graph_node_handle(g, id);
+    case IT_EDGE:
+    case IT_LABEL:
+    case IT_CRTL_PT1:
+    case IT_CRTL_PT2:
+        return graph_edge_handle(g, id);
+    default:
+        return (Handle){id, 0};
+    }
+}
 
-int main(void)
+// `h` of kind `type` is none or still refers to the item it was taken from
+internal bool item_handle_valid(Graph *g, int type, Handle h)
 {
-    // enable debug tracing
-    SetTraceLogLevel(LOG_DEBUG);
+    if (h.id < 0) return true;
+    switch (type) {
+    case IT_NODE:
+    case IT_NEW_EDGE:
+        return graph_node_get(g, h) >= 0;
+    case IT_EDGE:
+    case IT_LABEL:
+    case IT_CRTL_PT1:
+    case IT_CRTL_PT2:
+        return graph_edge_get(g, h) >= 0;
+    default:
+        return true;
+    }
+}
 
-    InitWindow(SCREEN_WIDTH, SCREEN_HEGHT, "graphgui");
-    SetExitKey(KEY_Q);
+void draw_edges(int *ids, EdgeGeo *geo, Graph *g, EdgeBatch *batch, GraphCtx *ctx);
+
+inline internal Color node_color(Graph *g, int id)
+{
+    return (g->node_color[id].a)? g->node_color[id] : graph_color(GC_NODE);
+}
+
+// mouse and keyboard state for one frame. the app reads input only from here,
+// so it can be driven by raylib or by a script (see bench.c)
+typedef struct FrameInput {
+    Vector2 mouse;          // screen position
+    Vector2 mouse_delta;
+    float wheel;
+    bool left_pressed;
+    bool left_released;
+    bool right_down;
+    bool debug_key;
+    bool save_key;
+    bool undo_key;
+    bool redo_key;
+    bool delete_key;
+    bool shift_down;
+} FrameInput;
+
+typedef struct GraphApp {
     GraphCtx ctx;
-    ctx.font = LoadFontEx("/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", UI_FONT_SIZE, 0, 250);
+    Camera2D camera;
+    Graph g;
+    Adjacency adj;
+    GeoCache gc;
+    SpatialIndex si;
+    EdgeBatch batch;
+    Layer layer;
+    FrameStats stats;
+    Arena frame;            // temporaries of the current frame, see app_begin_frame()
+    int *visible_edges;     // in the frame arena
+    Vector2 selected_offset;
+    Vector2 drag_before;    // the value of the field dragged, when the drag started
+    Handle attached_node;   // of the control point dragged
+    int active_tool;
+    int last_tool;          // of the previous frame
+    Vector2 preview_node;
+    Rectangle graphics_area;
+    Vector2 mouseWorldPos;
+    NodePropWnd nodewnd;
+    bool gui_locked;
+    char file_path[1024];   // where Ctrl+S saves the graph
+    Loader loader;
+    bool loading;
+    Layout layout;
+    Journal journal;
+    Selection sel;
+    Vector2 band_start;     // corner of the selection rectangle, in world space
+    int *moved_ids;         // of the last bulk move
+    int palette;            // last color given by the Color button
+    int *node_map;          // new ids of the last compaction
+    int *edge_map;
+} GraphApp;
+
+FrameInput poll_input(void)
+{
+    FrameInput in = {0};
+    in.mouse         = GetMousePosition();
+    in.mouse_delta   = GetMouseDelta();
+    in.wheel         = GetMouseWheelMove();
+    in.left_pressed  = IsMouseButtonPressed(MOUSE_LEFT_BUTTON);
+    in.left_released = IsMouseButtonReleased(MOUSE_LEFT_BUTTON);
+    in.right_down    = IsMouseButtonDown(MOUSE_BUTTON_RIGHT);
+    in.debug_key     = IsKeyPressed(KEY_D);
+    in.save_key      = IsKeyDown(KEY_LEFT_CONTROL) && IsKeyPressed(KEY_S);
+    in.undo_key      = IsKeyDown(KEY_LEFT_CONTROL) && IsKeyPressed(KEY_Z);
+    in.redo_key      = IsKeyDown(KEY_LEFT_CONTROL) && IsKeyPressed(KEY_Y);
+    in.delete_key    = IsKeyPressed(KEY_DELETE);
+    in.shift_down    = IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+    return in;
+}
+
+// must be called after InitWindow()
+void app_init(GraphApp *app, int screen_width, int screen_height)
+{
+    *app = (GraphApp){0};
+    GraphCtx *ctx = &app->ctx;
+    ctx->font = LoadFontEx("/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", UI_FONT_SIZE, 0, 250);
     GuiLoadStyleDark();
-    // GuiSetFont(ctx.font);
+    // GuiSetFont(ctx->font);
+
+    app->camera.zoom = 1.0f;
+    ctx->zoom_coef = 1.0f;
+    ctx->show_control_pts = false;
+    ctx->show_stats = false;
+    ctx->batched = true;
+    ctx->cached_layer = true;
+    ctx->focused = HANDLE_NONE;
+    ctx->active = HANDLE_NONE;
+    ctx->id_type = IT_NONE;
+
+    spatial_init(&app->si);
+    app->batch.arena = &app->frame;
+    app->attached_node = HANDLE_NONE;
+    app->active_tool = TI_CURSOR;
+    app->last_tool = TI_CURSOR;
+    app->graphics_area = (Rectangle){96, 0, screen_width - 96, screen_height};
+    app->mouseWorldPos = (Vector2){96, 0};
+    snprintf(app->file_path, sizeof(app->file_path), "%s", DEFAULT_GRAPH_FILE);
+}
 
-    Camera2D camera = {0};
-    camera.zoom = 1.0f;
-    float scrollSpeed = 0.2f;
+// rebuild the adjacency index, the geometry cache and the spatial index after
+// the graph was replaced or edited in bulk
+void app_sync_graph(GraphApp *app)
+{
+    Graph *g = &app->g;
+    adjacency_build(&app->adj, g);
+    geo_cache_free(&app->gc);
+    spatial_free(&app->si);
+    spatial_init(&app->si);
+
+    graph_foreach_node(g, i)
+        spatial_add_node(&app->si, graph_node_pos(g, i));
+    graph_foreach_edge(g, i) {
+        geo_cache_add_edge(&app->gc);
+        spatial_add_edge(&app->si);
+    }
+    selection_resize(&app->sel, graph_num_nodes(g), graph_num_edges(g));
+    layer_invalidate(&app->layer);
+}
 
-    Vector2 *nodes = NULL;
-    {
-        Vector2 v1 = {SCREEN_WIDTH/3, SCREEN_HEGHT/2};
-        Vector2 v2 = {2*SCREEN_WIDTH/3, SCREEN_HEGHT/2};
-        Vector2 v3 = {SCREEN_WIDTH/2, SCREEN_HEGHT*0.7f};
-        da_append(nodes, v1);
-        da_append(nodes, v2);
-        da_append(nodes, v3);
-    };
-
-    Edge *edges = NULL;
-    {
-        da_append(edges, ((Edge){
-            0, 1, {
-                { 100, -90},
-                {0, -120}
-            },
-            {0, 0},
-            "hello"
-        }));
-
-        da_append(edges, ((Edge){
-            1, 0, {
-                { -80, -90},
-                {130, 0}
-            },
-            {0, 0},
-            "   "
-        }));
-
-        da_append(edges, ((Edge){
-            0, 2, {
-                { 0, 80},
-                {-75, 0}
-            },
-            {0, 0},
-            "world"
-        }));
-
-        da_append(edges, ((Edge){
-            1, 2, {
-                { 0, 100},
-                {70, 60}
-            },
-            {0, 0},
-            "!"
-        }));
-
-        da_append(edges, ((Edge){
-            1, 1, {
-                { 90, -50},
-                {90, 50}
-            },
-            {0, 0},
-            "repeat"
-        }));
-
-    }
-
-    EdgeGeo *edge_geo = NULL;
-    for(size_t i = 0; i < da_size(edges); i++)
-        da_append(edge_geo, (EdgeGeo){0});
-
-    ctx.show_control_pts = false;
-    ctx.focused = -1;
-    ctx.active = -1;
-    ctx.id_type = IT_NONE;
-    Vector2 selected_offset = {0};
-    Vector2 *attached_node = NULL;
-    int active_tool = TI_CURSOR;
-    Vector2 preview_node;
-    Rectangle graphics_area = {96, 0, SCREEN_WIDTH - 96, SCREEN_HEGHT};
-    Vector2 mouseWorldPos = {96, 0};
-    NodePropWnd nodewnd = {0};
-    bool gui_locked = false;
-    // bool hovering = true;
+// recompute the dirty edges and follow them in the spatial index
+void app_update_geometry(GraphApp *app)
+{
+    prof_zone(PZ_GEOMETRY) {
+        geo_cache_update(&app->gc, &app->g, &app->ctx);
+        for(size_t i = 0; i < da_size(app->gc.updated); i++) {
+            int id = app->gc.updated[i];
+            spatial_update_edge(&app->si, id, app->gc.geo + id);
+        }
+    }
+    app->stats.edges_rebuilt = app->gc.rebuilt;
+}
 
+// replace the graph with `g`, Ctrl+S will save it to `path`
+void app_set_graph(GraphApp *app, Graph *g, const char *path)
+{
+    graph_free(&app->g);
+    app->g = *g;
+    app->ctx.focused = HANDLE_NONE;
+    app->ctx.active = HANDLE_NONE;
+    app->ctx.id_type = IT_NONE;
+    app->attached_node = HANDLE_NONE;
+    journal_clear(&app->journal);
+    selection_clear(&app->sel);
+    snprintf(app->file_path, sizeof(app->file_path), "%s", path);
+
+    double start = now_ms();
+    app_sync_graph(app);
+    app_update_geometry(app);
+    TraceLog(LOG_INFO, "GRAPH: %d nodes and %d edges indexed in %.2f ms", graph_num_nodes(&app->g),
+            graph_num_edges(&app->g), now_ms() - start);
+}
 
-    SetTargetFPS(30);
+// replace the graph with the one in the file at `path`, which becomes the file
+// Ctrl+S saves to. the current graph is kept when loading fails
+bool app_load(GraphApp *app, const char *path)
+{
+    Graph g = {0};
+    double start = now_ms();
+    if (!graph_load(&g, path)) return false;
+    TraceLog(LOG_INFO, "GRAPH: loaded %s in %.2f ms", path, now_ms() - start);
+    app_set_graph(app, &g, path);
+    return true;
+}
 
-    while(!WindowShouldClose()) {
-        // camera.zoom += (int)(GetMouseWheelMove()*scrollSpeed);
-        {
-            float new_zoom = camera.zoom * (1.0f + (float)GetMouseWheelMove()*0.15f);
-            if(new_zoom < 0.05f) new_zoom = 0.05f;
-            if(new_zoom > 800.0f) new_zoom = 800.0f;
-            float s = (new_zoom - camera.zoom)/(new_zoom*camera.zoom);
-            camera.target = Vector2Add(camera.target, Vector2Scale(GetMousePosition(), s));
-            camera.zoom = new_zoom;
-        }
-
-        // pan control
-        if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT))
-        {
-            Vector2 delta = GetMouseDelta();
-            delta = Vector2Scale(delta, -1.0f/camera.zoom);
-            camera.target = Vector2Add(camera.target, delta);
-        }
-
-        // dirty hack: stop update mouseWorldPos when out of graphics area
-        // TODO: study how to disable intractions with graphcs objects that
-        // would be visible inside non graphics regions of the screen.
-        //  - virtual mouse click:
-        //      replace IsMouseButtonPressed and similiar with a virtual version
-        //      buttonPressedVirtual(). they are masket to false when outside
-        //       - disadvantage: if I'm interacting with an object inside graphics
-        //         region, and moove out of GA, the curent development with
-        //         object is lost.
-        // - trap the mouse within graphics region until interaction is over.
-
-        if (CheckCollisionPointRec(GetMousePosition(), graphics_area))
-            mouseWorldPos = GetScreenToWorld2D(GetMousePosition(), camera);
-
-        if (IsKeyPressed(KEY_D)) {
-            // TraceLog(LOG_DEBUG, "item active/focused: %d, %d, %d", ctx.id_type, ctx.active, ctx.focused);
-            TraceLog(LOG_DEBUG, "camera zoom %f", camera.zoom);
-            // TraceLog(LOG_DEBUG, "wheel %f", GetMouseWheelMove());
-        }
-
-        if (gui_locked) {
-            GuiLock();
-        } else {
-            GuiUnlock();
+// open a graph file, or start importing a text file on a worker thread. the
+// imported graph replaces the current one right away and grows in the next
+// frames. an import in progress is canceled
+bool app_open(GraphApp *app, const char *path)
+{
+    if (app->loading) {
+        loader_end(&app->loader);
+        app->loading = false;
+    }
+    if (IsFileExtension(path, ".grph")) return app_load(app, path);
+
+    app->loading = loader_start(&app->loader, path, import_format_from_path(path));
+    if (!app->loading) return false;
+
+    // saved next to the imported file
+    char grph_path[sizeof(app->file_path)];
+    snprintf(grph_path, sizeof(grph_path), "%s", path);
+    char *dot = strrchr(grph_path, '.');
+    char *slash = strrchr(grph_path, '/');
+    if (dot && (!slash || dot > slash)) *dot = '\0';
+    strncat(grph_path, ".grph", sizeof(grph_path) - strlen(grph_path) - 1);
+    Graph empty = {0};
+    app_set_graph(app, &empty, grph_path);
+    return true;
+}
+
+// append a batch of the loader to the graph, the adjacency index, the geometry
+// cache and the spatial index
+internal void app_add_batch(GraphApp *app, ImportBatch *b)
+{
+    Graph *g = &app->g;
+    int first_node = graph_num_nodes(g);
+    int first_edge = graph_num_edges(g);
+    import_batch_apply(g, b, &app->loader.label_map);
+
+    for (int i = first_node; i < graph_num_nodes(g); i++)
+        spatial_add_node(&app->si, graph_node_pos(g, i));
+    for (int i = first_edge; i < graph_num_edges(g); i++) {
+        adjacency_add_edge(&app->adj, i, g->from[i], g->to[i]);
+        geo_cache_add_edge(&app->gc);
+        spatial_add_edge(&app->si);
+    }
+    if (adjacency_stale(&app->adj)) adjacency_build(&app->adj, g);
+    for (size_t i = 0; i < da_size(b->moved_node); i++) {
+        int node = b->moved_node[i];
+        geo_cache_touch_node(&app->gc, &app->adj, node);
+        spatial_update_node(&app->si, node, graph_node_pos(g, node));
+    }
+    for (size_t i = 0; i < da_size(b->relabeled_edge); i++)
+        geo_cache_touch_edge(&app->gc, b->relabeled_edge[i]);
+    selection_resize(&app->sel, graph_num_nodes(g), graph_num_edges(g));
+    layer_invalidate(&app->layer);      // the new nodes bump no version
+}
+
+// take the batches parsed by the loader for about LOAD_FRAME_BUDGET_MS, the
+// geometry of their edges included, and at least one per frame. when the
+// import fails the graph read so far is kept
+internal void app_load_step(GraphApp *app)
+{
+    Loader *l = &app->loader;
+    double start = now_ms();
+    ImportBatch b;
+    while (now_ms() - start < LOAD_FRAME_BUDGET_MS && loader_next(l, &b)) {
+        prof_zone(PZ_IMPORT) {
+            app_add_batch(app, &b);
         }
+        import_batch_free(&b);
+        app_update_geometry(app);
+    }
+    if (!loader_done(l)) return;
+
+    if (l->imp.status == IS_DONE) {
+        TraceLog(LOG_INFO, "IMPORT: done, %d nodes and %d edges", graph_num_nodes(&app->g),
+                graph_num_edges(&app->g));
+    } else {
+        TraceLog(LOG_WARNING, "IMPORT: failed after %zu bytes: %s", l->imp.bytes_done,
+                l->imp.error);
+    }
+    loader_end(l);
+    app->loading = false;
+}
+
+// items under `p`, see spatial_pick()
+internal SpatialPick app_pick(GraphApp *app, Vector2 p)
+{
+    SpatialPick result;
+    prof_zone(PZ_HIT_TEST) {
+        float control_radius_world = CONTROL_RADIUS / app->camera.zoom;
+        float curve_radius_world = EDGE_THICKNESS/2 + CURVE_PICK_MARGIN / app->camera.zoom;
+        result = spatial_pick(&app->si, p, control_radius_world, app->ctx.show_control_pts,
+                curve_radius_world, &app->g, app->gc.geo);
+    }
+    return result;
+}
 
-        if (active_tool == TI_CURSOR) {
-            // if (IsKeyPressed(KEY_C))
-            //     ctx.show_control_pts = !ctx.show_control_pts;
+// add a node in a free slot or at the end, with the caches following it
+int app_add_node(GraphApp *app, Vector2 pos)
+{
+    Graph *g = &app->g;
+    int num_nodes = graph_num_nodes(g);
+    int id = graph_add_node(g, pos);
+    if (id == num_nodes) {
+        spatial_add_node(&app->si, pos);
+    } else {
+        spatial_update_node(&app->si, id, pos);
+    }
+    geo_cache_touch_node(&app->gc, &app->adj, id);
+    selection_resize(&app->sel, graph_num_nodes(g), graph_num_edges(g));
+    return id;
+}
 
-            // move nodes
-            if (ctx.id_type == IT_NODE && ctx.active >= 0) {
-                if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
-                    ctx.focused = -1;
-                    ctx.active  = -1;
-                    ctx.id_type = -1;
-                } else
-                nodes[ctx.active] = Vector2Add(mouseWorldPos, selected_offset);
-            }
+// add an edge curving from `from` to `to`, its geometry is computed by the next
+// geometry update
+int app_add_edge(GraphApp *app, int from, int to)
+{
+    Graph *g = &app->g;
+    Vector2 c1, c2;
+    edge_default_ctrl(graph_node_pos(g, from), graph_node_pos(g, to), from == to, &c1, &c2);
+    int id = graph_add_edge(g, from, to, c1, c2, (Vector2){0}, "");
+    adjacency_add_edge(&app->adj, id, from, to);
+    if (id == (int)da_size(app->gc.edge_version)) {
+        geo_cache_add_edge(&app->gc);
+        spatial_add_edge(&app->si);
+    } else {
+        geo_cache_touch_edge(&app->gc, id);
+    }
+    selection_resize(&app->sel, graph_num_nodes(g), graph_num_edges(g));
+    return id;
+}
 
-            // move edges
-            if (ctx.id_type == IT_LABEL && ctx.active >= 0) {
-                if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
-                    ctx.focused = -1;
-                    ctx.active  = -1;
-                    ctx.id_type = -1;
-                } else
+// remove an edge, in O(1) or O(degree) of its nodes when it was added since the
+// adjacency index was built
+void app_remove_edge(GraphApp *app, int edge)
+{
+    Graph *g = &app->g;
+    adjacency_remove_edge(&app->adj, edge, g->from[edge], g->to[edge]);
+    spatial_remove_edge(&app->si, edge);
+    selection_set_edge(&app->sel, edge, false);
+    graph_remove_edge(g, edge);
+    layer_invalidate(&app->layer);
+}
 
-                edges[ctx.active].loffset = Vector2Add(mouseWorldPos, selected_offset);
-            }
+// remove a node and its edges, found in the adjacency index
+void app_remove_node(GraphApp *app, int node)
+{
+    Arena_Mark mark = arena_snapshot(&app->frame);
+    int *incident = NULL;
+    adjacency_incident(&app->adj, &app->g, node, &app->frame, &incident);
+    for (size_t i = 0; i < da_size(incident); i++)
+        app_remove_edge(app, incident[i]);
+    arena_rewind(&app->frame, mark);
+    spatial_remove_node(&app->si, node);
+    selection_set_node(&app->sel, node, false);
+    graph_remove_node(&app->g, node);
+    layer_invalidate(&app->layer);
+}
 
-            if (ctx.active < 0) {
-                ctx.focused = -1;
-                ctx.id_type = -1;
-                ctx.active = -1;
+// the handle of an item after a compaction, for the item types of IdType
+internal Handle app_remap_item(GraphApp *app, int type, Handle h)
+{
+    if (h.id < 0) return h;
+    int id = h.id;
+    switch (type) {
+    case IT_NODE:
+    case IT_NEW_EDGE:
+        id = app->node_map[id];
+        break;
+    case IT_EDGE:
+    case IT_LABEL:
+    case IT_CRTL_PT1:
+    case IT_CRTL_PT2:
+        id = app->edge_map[id];
+        break;
+    default:
+        return h;
+    }
+    return (id < 0)? HANDLE_NONE : item_handle(&app->g, type, id);
+}
+
+// drop the interaction in progress when the item it holds was removed, or its
+// slot reused, since it started
+internal void app_check_handles(GraphApp *app)
+{
+    GraphCtx *ctx = &app->ctx;
+    Graph *g = &app->g;
+    bool ctrl_pt = ctx->id_type == IT_CRTL_PT1 || ctx->id_type == IT_CRTL_PT2;
+    if (!item_handle_valid(g, ctx->id_type, ctx->active)
+            || (ctrl_pt && ctx->active.id >= 0 && graph_node_get(g, app->attached_node) < 0)) {
+        ctx->active = HANDLE_NONE;
+        ctx->focused = HANDLE_NONE;
+        ctx->id_type = IT_NONE;
+    } else if (!item_handle_valid(g, ctx->id_type, ctx->focused)) {
+        ctx->focused = HANDLE_NONE;
+    }
+}
+
+// when a quarter of the slots, and at least COMPACT_MIN_FREE, are free
+internal bool app_fragmented(GraphApp *app)
+{
+    Graph *g = &app->g;
+    int free_slots = da_size(g->free_nodes) + da_size(g->free_edges);
+    return free_slots >= COMPACT_MIN_FREE && 4*free_slots >= graph_num_nodes(g) + graph_num_edges(g);
+}
+
+// drop the free slots left by removals, see graph_compact(). the caches are
+// rebuilt, and the selection, the history and the items held by the app
+// follow the new ids. not while importing, the batches refer to the ids
+void app_compact(GraphApp *app)
+{
+    Graph *g = &app->g;
+    GraphCtx *ctx = &app->ctx;
+    if (app->loading || !graph_has_free_slots(g)) return;
+    double start = now_ms();
+    int free_nodes = da_size(g->free_nodes);
+    int free_edges = da_size(g->free_edges);
+    graph_compact(g, &app->node_map, &app->edge_map);
+
+    selection_remap(&app->sel, app->node_map, app->edge_map);
+    journal_remap(&app->journal, app->node_map, app->edge_map);
+    ctx->focused = app_remap_item(app, ctx->id_type, ctx->focused);
+    ctx->active = app_remap_item(app, ctx->id_type, ctx->active);
+    app->attached_node = app_remap_item(app, IT_NODE, app->attached_node);
+    for (size_t i = 0; i < da_size(app->moved_ids); i++)
+        app->moved_ids[i] = app->node_map[app->moved_ids[i]];
+
+    app_sync_graph(app);
+    TraceLog(LOG_INFO, "GRAPH: %d free nodes and %d free edges compacted in %.2f ms",
+            free_nodes, free_edges, now_ms() - start);
+}
+
+// follow every node in the geometry cache and the spatial index, after a layout
+internal void app_touch_all_nodes(GraphApp *app)
+{
+    Graph *g = &app->g;
+    graph_foreach_node(g, i) {
+        geo_cache_touch_node(&app->gc, &app->adj, i);
+        spatial_update_node(&app->si, i, graph_node_pos(g, i));
+    }
+}
+
+// run the auto layout while its tool is selected, until it settles. selecting
+// the tool again restarts it
+internal void app_layout_step(GraphApp *app)
+{
+    Graph *g = &app->g;
+    if (app->last_tool != TI_LAYOUT) {
+        app_compact(app);
+        layout_start(&app->layout, g);
+        journal_clear(&app->journal);
+    }
+    if (!layout_running(&app->layout)) return;
+    prof_zone(PZ_LAYOUT) {
+        layout_step(&app->layout, g, LAYOUT_FRAME_BUDGET_MS);
+    }
+    app_touch_all_nodes(app);
+}
+
+// lay the graph out in layers, top to bottom. the auto layout is stopped
+void app_hierarchy_layout(GraphApp *app)
+{
+    if (app->loading) return;
+    if (app->active_tool == TI_LAYOUT) app->active_tool = TI_CURSOR;
+    app_compact(app);
+    Hierarchy h = {0};
+    prof_zone(PZ_LAYOUT) {
+        hierarchy_layout(&h, &app->g);
+    }
+    TraceLog(LOG_INFO, "LAYOUT: %d layers, %d dummy nodes, %ld crossings after %d sweeps, "
+            "%.2f ms", h.num_layers, h.num_dummies, h.crossings, h.sweeps,
+            h.cycles_ms + h.layers_ms + h.order_ms + h.coords_ms);
+    hierarchy_free(&h);
+    journal_clear(&app->journal);
+    app_touch_all_nodes(app);
+}
+
+// move `n` nodes by `delta`, their edges are rebuilt together by the next
+// geometry update
+internal void app_move_nodes(GraphApp *app, int *ids, int n, Vector2 delta)
+{
+    Graph *g = &app->g;
+    for (int k = 0; k < n; k++) {
+        int i = ids[k];
+        Vector2 pos = Vector2Add(graph_node_pos(g, i), delta);
+        graph_set_node_pos(g, i, pos);
+        geo_cache_touch_node(&app->gc, &app->adj, i);
+        spatial_update_node(&app->si, i, pos);
+    }
+}
+
+// the same for the selected nodes, whose ids are left in `moved_ids`
+internal void app_move_selection(GraphApp *app, Vector2 delta)
+{
+    da_size(app->moved_ids) = 0;
+    selection_foreach_node(&app->sel, i) da_append(app->moved_ids, i);
+    app_move_nodes(app, app->moved_ids, da_size(app->moved_ids), delta);
+}
+
+// set the field of an edit to its value before (`undo`) or after the edit
+internal void app_apply_edit(GraphApp *app, JournalEntry *e, bool undo)
+{
+    Graph *g = &app->g;
+    int id = e->id;
+    Vector2 value = (undo)? e->before : e->after;
+    switch ((enum JournalKind)e->kind) {
+    case JK_NODE_POS:
+        graph_set_node_pos(g, id, value);
+        geo_cache_touch_node(&app->gc, &app->adj, id);
+        spatial_update_node(&app->si, id, value);
+        break;
+    case JK_LOFFSET:
+        g->loffset[id] = value;
+        geo_cache_touch_edge(&app->gc, id);
+        break;
+    case JK_CTRL1:
+    case JK_CTRL2:
+        g->ctrl[e->kind - JK_CTRL1][id] = value;
+        geo_cache_touch_edge(&app->gc, id);
+        break;
+    case JK_MOVE_NODES:
+        app_move_nodes(app, e->ids, e->num_ids, (undo)? Vector2Negate(e->after) : e->after);
+        break;
+    }
+}
+
+// at the end of a drag, record it when it changed something
+internal void app_record_edit(GraphApp *app, enum JournalKind kind, int id, Vector2 after)
+{
+    if (Vector2Equals(app->drag_before, after)) return;
+    journal_record(&app->journal, kind, id, app->drag_before, after);
+}
+
+void app_undo(GraphApp *app)
+{
+    JournalEntry *e = journal_undo(&app->journal);
+    if (e) app_apply_edit(app, e, true);
+}
+
+void app_redo(GraphApp *app)
+{
+    JournalEntry *e = journal_redo(&app->journal);
+    if (e) app_apply_edit(app, e, false);
+}
+
+// select the nodes and the labels inside `r`, with the edges between the
+// selected nodes
+internal void app_select_rect(GraphApp *app, Rectangle r)
+{
+    Graph *g = &app->g;
+    Selection *sel = &app->sel;
+    SpatialKey *keys = NULL;
+    spatial_query(&app->si, r, g, app->gc.geo, &app->frame, &keys);
+    for (size_t i = 0; i < da_size(keys); i++) {
+        SpatialKey key = keys[i];
+        if (key.type == IT_NODE) {
+            selection_set_node(sel, key.id, true);
+        } else {
+            selection_set_edge(sel, key.id, true);
+        }
+    }
+    if (sel->num_nodes > 1) {
+        selection_foreach_node(sel, v) {
+            for (AdjCursor c = adjacency_begin(&app->adj, AD_OUT, v);
+                    adjacency_next(&app->adj, AD_OUT, v, &c); ) {
+                if (selection_has_node(sel, g->to[c.e])) selection_set_edge(sel, c.e, true);
             }
+        }
+    }
+}
 
-            // all nodes
-            for (size_t i = 0; i < da_size(nodes); i++) {
-                if (CheckCollisionPointCircle(mouseWorldPos, nodes[i], NODE_RADIUS)) {
-                    focus(IT_NODE, i);
-                }
-                if (ctx.id_type == IT_NODE && ctx.focused == (int)i) {
-                    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                        ctx.active      = i;
-                        selected_offset = Vector2Subtract(nodes[i], mouseWorldPos);
-                    }
-                    break;
+// remove the selected nodes and edges, with the edges of the nodes. it can't
+// be undone, the history is cleared
+void app_delete_selection(GraphApp *app)
+{
+    Selection *sel = &app->sel;
+    if (app->loading || (sel->num_nodes == 0 && sel->num_edges == 0)) return;
+    graph_remove_many(&app->g, sel->nodes, sel->edges, NULL, NULL);
+    selection_clear(sel);
+    journal_clear(&app->journal);
+    app->ctx.focused = HANDLE_NONE;
+    app->ctx.active = HANDLE_NONE;
+    app->ctx.id_type = IT_NONE;
+    app_sync_graph(app);
+}
+
+// give the next color of the palette to the selected nodes and edges
+void app_recolor_selection(GraphApp *app)
+{
+    app->palette = (app->palette + 1) % ARRAYSIZE(global_palette);
+    Color color = global_palette[app->palette];
+    selection_foreach_node(&app->sel, i) app->g.node_color[i] = color;
+    selection_foreach_edge(&app->sel, i) app->g.edge_color[i] = color;
+    layer_invalidate(&app->layer);
+}
+
+inline internal Rectangle band_rect(Vector2 a, Vector2 b)
+{
+    Rectangle result = {fminf(a.x, b.x), fminf(a.y, b.y), fabsf(a.x - b.x), fabsf(a.y - b.y)};
+    return result;
+}
+
+typedef struct CullJob {
+    EdgeGeo *geo;
+    int *from;          // < 0 for the free slots
+    int num_edges;
+    Rectangle view;
+    int **ids;          // per block, in the scratch arena of the thread that culled it
+    int *counts;
+} CullJob;
+
+// the visible edges of blocks [begin, end)
+internal void cull_edges_range(void *data, int begin, int end)
+{
+    CullJob *job = data;
+    Arena *scratch = job_scratch();
+    arena_set_allign(scratch, 8);
+    for (int b = begin; b < end; b++) {
+        int first = b*CULL_BLOCK;
+        int last = (first + CULL_BLOCK < job->num_edges)? first + CULL_BLOCK : job->num_edges;
+        int ids[CULL_BLOCK];
+        int n = 0;
+        for (int i = first; i < last; i++) {
+            if (job->from[i] >= 0 && CheckCollisionRecs(edge_bounds(job->geo + i), job->view))
+                ids[n++] = i;
+        }
+        job->ids[b] = arena_push_size(scratch, n*sizeof(int));
+        memcpy(job->ids[b], ids, n*sizeof(int));
+        job->counts[b] = n;
+    }
+}
+
+// fill app->visible_edges, in the frame arena, with the edges overlapping
+// `view` in id order. blocks of edges are culled in parallel and then packed
+// together
+internal void app_cull_edges(GraphApp *app, Rectangle view)
+{
+    int num_edges = graph_num_edges(&app->g);
+    int num_blocks = (num_edges + CULL_BLOCK - 1)/CULL_BLOCK;
+    arena_set_allign(&app->frame, 8);
+    CullJob job = {app->gc.geo, app->g.from, num_edges, view,
+            arena_push_size(&app->frame, num_blocks*sizeof(int *)),
+            arena_push_size(&app->frame, num_blocks*sizeof(int))};
+    job_parallel_for(&global_jobs, num_blocks, 1, cull_edges_range, &job);
+
+    size_t n = 0;
+    for (int b = 0; b < num_blocks; b++) n += job.counts[b];
+    app->visible_edges = NULL;
+    arena_da_reserve(&app->frame, app->visible_edges, n);
+    for (int b = 0; b < num_blocks; b++)
+        arena_da_append_many(&app->frame, app->visible_edges, job.ids[b], job.counts[b]);
+}
+
+bool app_save(GraphApp *app)
+{
+    app_compact(app);
+    bool ok = graph_save(&app->g, app->file_path);
+    if (ok) TraceLog(LOG_INFO, "GRAPH: saved %s", app->file_path);
+    return ok;
+}
+
+// start a frame: everything in the frame arena of the previous one is dropped
+void app_begin_frame(GraphApp *app)
+{
+    arena_reset(&app->frame);
+    app->visible_edges = NULL;
+}
+
+void app_update(GraphApp *app, FrameInput *in)
+{
+    prof_frame_begin();
+    if (app->loading) app_load_step(app);
+    app_check_handles(app);
+    prof_begin(PZ_INPUT);
+    GraphCtx *ctx = &app->ctx;
+    Graph *g = &app->g;
+    Camera2D *camera = &app->camera;
+
+    // camera.zoom += (int)(GetMouseWheelMove()*scrollSpeed);
+    {
+        float new_zoom = camera->zoom * (1.0f + in->wheel*0.15f);
+        if(new_zoom < MIN_ZOOM) new_zoom = MIN_ZOOM;
+        if(new_zoom > MAX_ZOOM) new_zoom = MAX_ZOOM;
+        float s = (new_zoom - camera->zoom)/(new_zoom*camera->zoom);
+        camera->target = Vector2Add(camera->target, Vector2Scale(in->mouse, s));
+        camera->zoom = new_zoom;
+    }
+
+    // pan control
+    if (in->right_down)
+    {
+        Vector2 delta = in->mouse_delta;
+        delta = Vector2Scale(delta, -1.0f/camera->zoom);
+        camera->target = Vector2Add(camera->target, delta);
+    }
+
+    // dirty hack: stop update mouseWorldPos when out of graphics area
+    // TODO: study how to disable intractions with graphcs objects that
+    // would be visible inside non graphics regions of the screen.
+    //  - virtual mouse click:
+    //      replace IsMouseButtonPressed and similiar with a virtual version
+    //      buttonPressedVirtual(). they are masket to false when outside
+    //       - disadvantage: if I'm interacting with an object inside graphics
+    //         region, and moove out of GA, the curent development with
+    //         object is lost.
+    // - trap the mouse within graphics region until interaction is over.
+
+    if (CheckCollisionPointRec(in->mouse, app->graphics_area))
+        app->mouseWorldPos = GetScreenToWorld2D(in->mouse, *camera);
+    Vector2 mouseWorldPos = app->mouseWorldPos;
+
+    if (in->debug_key) {
+        // TraceLog(LOG_DEBUG, "item active/focused: %d, %d, %d", ctx->id_type, ctx->active.id, ctx->focused.id);
+        TraceLog(LOG_DEBUG, "camera zoom %f", camera->zoom);
+        // TraceLog(LOG_DEBUG, "wheel %f", GetMouseWheelMove());
+    }
+
+    if (in->save_key) app_save(app);
+    // not in the middle of a drag
+    if (ctx->active.id < 0) {
+        if (in->undo_key) app_undo(app);
+        if (in->redo_key) app_redo(app);
+        if (in->delete_key) app_delete_selection(app);
+    }
+
+    if (app->gui_locked) {
+        GuiLock();
+    } else {
+        GuiUnlock();
+    }
+
+    if (app->active_tool == TI_CURSOR) {
+        // if (IsKeyPressed(KEY_C))
+        //     ctx->show_control_pts = !ctx->show_control_pts;
+
+        // move nodes
+        if (ctx->id_type == IT_NODE && ctx->active.id >= 0) {
+            bool bulk = selection_has_node(&app->sel, ctx->active.id);
+            if (in->left_released) {
+                Vector2 pos = graph_node_pos(g, ctx->active.id);
+                if (bulk && !Vector2Equals(app->drag_before, pos)) {
+                    journal_record_move(&app->journal, app->moved_ids, da_size(app->moved_ids),
+                            Vector2Subtract(pos, app->drag_before));
+                } else if (!bulk) {
+                    app_record_edit(app, JK_NODE_POS, ctx->active.id, pos);
                 }
+                ctx->focused = HANDLE_NONE;
+                ctx->active  = HANDLE_NONE;
+                ctx->id_type = -1;
+            } else if (bulk) {
+                Vector2 pos = Vector2Add(mouseWorldPos, app->selected_offset);
+                app_move_selection(app, Vector2Subtract(pos, graph_node_pos(g, ctx->active.id)));
+            } else {
+                Vector2 pos = Vector2Add(mouseWorldPos, app->selected_offset);
+                graph_set_node_pos(g, ctx->active.id, pos);
+                geo_cache_touch_node(&app->gc, &app->adj, ctx->active.id);
+                spatial_update_node(&app->si, ctx->active.id, pos);
             }
+        }
 
-            // all edges
-            if (ctx.id_type == IT_CRTL_PT1 || ctx.id_type == IT_CRTL_PT2) {
-                if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
-                    ctx.id_type = -1;
-                    ctx.active = -1;
-                    ctx.focused = -1;
-                }
+        // move edges
+        if (ctx->id_type == IT_LABEL && ctx->active.id >= 0) {
+            if (in->left_released) {
+                app_record_edit(app, JK_LOFFSET, ctx->active.id, g->loffset[ctx->active.id]);
+                ctx->focused = HANDLE_NONE;
+                ctx->active  = HANDLE_NONE;
+                ctx->id_type = -1;
+            } else {
+                g->loffset[ctx->active.id] = Vector2Add(mouseWorldPos, app->selected_offset);
+                geo_cache_touch_edge(&app->gc, ctx->active.id);
             }
-            float control_radius_world = CONTROL_RADIUS / camera.zoom;
-            for (size_t i = 0; i < da_size(edges); i++) {
-                Edge e = edges[i];
-                compute_edge_geo(edge_geo + i, nodes[e.from], nodes[e.to], e.ctrl[0], e.ctrl[1],
-                                 e.loffset, e.label, &ctx);
-
-                if (ctx.show_control_pts) {
-                    // control point 1
-                    if (CheckCollisionPointCircle(mouseWorldPos, edge_geo[i].points[EI_C1A],
-                                                  control_radius_world )) {
-                        focus(IT_CRTL_PT1, i);
-                        // TraceLog(LOG_DEBUG, "control 1");
-                    }
-                    if (ctx.id_type == IT_CRTL_PT1 && ctx.focused == (int)i) {
-                        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                            ctx.active    = i;
-                            ctx.id_type   = IT_CRTL_PT1;
-                            attached_node = &nodes[e.from];
-                        }
-                        break;
-                    }
+        }
 
+        // a curve clicked is held until the button is released
+        if (ctx->id_type == IT_EDGE && ctx->active.id >= 0 && in->left_released) {
+            ctx->focused = HANDLE_NONE;
+            ctx->active  = HANDLE_NONE;
+            ctx->id_type = -1;
+        }
 
-                    // control point 2
+        // rubber band
+        if (ctx->id_type == IT_BAND && ctx->active.id >= 0 && in->left_released) {
+            app_select_rect(app, band_rect(app->band_start, mouseWorldPos));
+            ctx->active = HANDLE_NONE;
+        }
 
-                    if (CheckCollisionPointCircle(mouseWorldPos, edge_geo[i].points[EI_C2A],
-                                                  control_radius_world)) {
-                        focus(IT_CRTL_PT2, i);
-                        // TraceLog(LOG_DEBUG, "control 2");
-                    }
-                    if (ctx.id_type == IT_CRTL_PT2 && ctx.focused == (int)i) {
-                        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                            ctx.active    = i;
-                            ctx.id_type   = IT_CRTL_PT2;
-                            attached_node = &nodes[e.to];
-                        }
-                        break;
-                    }
-                }
+        if (ctx->active.id < 0) {
+            ctx->focused = HANDLE_NONE;
+            ctx->id_type = -1;
+            ctx->active = HANDLE_NONE;
+        }
 
-                // label
-                Rectangle rec = label_rect(edge_geo + i);
-                if (CheckCollisionPointRec(mouseWorldPos, rec)) {
-                    focus(IT_LABEL, i);
-                }
-                if (ctx.id_type == IT_LABEL && ctx.focused == (int)i) {
-                    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                        ctx.active      = i;
-                        ctx.id_type     = IT_LABEL;
-                        selected_offset = Vector2Subtract(e.loffset, mouseWorldPos);
+        // hover and pick
+        SpatialPick pick = app_pick(app, mouseWorldPos);
+
+        // nodes
+        if (pick.node >= 0) {
+            int i = pick.node;
+            focus(ctx, IT_NODE, graph_node_handle(g, i));
+            if (ctx->id_type == IT_NODE && ctx->focused.id == i) {
+                if (in->left_pressed) {
+                    // shift toggles the node, a click elsewhere than on the
+                    // selection clears it
+                    bool selected = selection_has_node(&app->sel, i);
+                    if (in->shift_down) {
+                        selection_set_node(&app->sel, i, !selected);
+                    } else if (!selected) {
+                        selection_clear(&app->sel);
                     }
-                    break;
+                    ctx->active         = graph_node_handle(g, i);
+                    app->selected_offset = Vector2Subtract(graph_node_pos(g, i), mouseWorldPos);
+                    app->drag_before    = graph_node_pos(g, i);
+                    da_size(app->moved_ids) = 0;
                 }
             }
+        }
 
-            // move control points
-            if ((ctx.id_type == IT_CRTL_PT1 || ctx.id_type == IT_CRTL_PT2) && ctx.active >= 0) {
-                Vector2 new_ctrl_pos = Vector2Subtract(mouseWorldPos, *attached_node);
-                float d              = Vector2Length(new_ctrl_pos);
-                if (d < 0.1f) {
-                    new_ctrl_pos = (Vector2){ MIN_CONTROL_DISTANCE, 0 };
-                } else if (d < MIN_CONTROL_DISTANCE)
-                    new_ctrl_pos = Vector2Scale(new_ctrl_pos, MIN_CONTROL_DISTANCE / d);
-                edges[ctx.active].ctrl[ctx.id_type - IT_CRTL_PT1] = new_ctrl_pos;
+        // edges
+        if (ctx->id_type == IT_CRTL_PT1 || ctx->id_type == IT_CRTL_PT2) {
+            if (in->left_released && ctx->active.id >= 0) {
+                int c = ctx->id_type - IT_CRTL_PT1;
+                app_record_edit(app, JK_CTRL1 + c, ctx->active.id, g->ctrl[c][ctx->active.id]);
             }
-        } else
-
-        // add node
-        if (active_tool == TI_ADD_NODE) {
-            if (ctx.active < 0) {
-                ctx.focused = -1;
-                ctx.id_type = -1;
-                ctx.active = -1;
+            if (in->left_released) {
+                ctx->id_type = -1;
+                ctx->active = HANDLE_NONE;
+                ctx->focused = HANDLE_NONE;
             }
-            preview_node = mouseWorldPos;
-            if (ctx.id_type == IT_DRAWING && ctx.active == 0) {
-                if(IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
-                    if (CheckCollisionPointRec(GetMousePosition(), graphics_area)){
-                        // da_append(nodes, mouseWorldPos);
-                        TraceLog(LOG_DEBUG, "node placed at: %f, %f", preview_node.x, preview_node.y);
-                    }
-                    ctx.focused = -1;
-                    ctx.id_type = -1;
-                    ctx.active = -1;
+        }
+        if (pick.edge.type != IT_NONE) {
+            int i = pick.edge.id;
+            int type = pick.edge.type;
+            focus(ctx, type, item_handle(g, type, i));
+            if (ctx->id_type == type && ctx->focused.id == i && in->left_pressed) {
+                ctx->active  = item_handle(g, type, i);
+                ctx->id_type = type;
+                if (type == IT_CRTL_PT1) {
+                    app->attached_node = graph_node_handle(g, g->from[i]);
+                    app->drag_before = g->ctrl[0][i];
+                } else if (type == IT_CRTL_PT2) {
+                    app->attached_node = graph_node_handle(g, g->to[i]);
+                    app->drag_before = g->ctrl[1][i];
+                } else if (type == IT_EDGE) {
+                    // a click on the curve selects the edge, shift toggles it
+                    bool selected = selection_has_edge(&app->sel, i);
+                    if (!in->shift_down) selection_clear(&app->sel);
+                    selection_set_edge(&app->sel, i, !in->shift_down || !selected);
+                } else {
+                    app->selected_offset = Vector2Subtract(g->loffset[i], mouseWorldPos);
+                    app->drag_before = g->loffset[i];
+                    if (in->shift_down)
+                        selection_set_edge(&app->sel, i, !selection_has_edge(&app->sel, i));
                 }
             }
-            if(CheckCollisionPointRec(GetMousePosition(), graphics_area))
-            {
-                focus(IT_DRAWING, 0);
-            }
-            if (ctx.id_type == IT_DRAWING && ctx.focused == 0) {
-                if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                    ctx.active = 0;
-                    ctx.id_type = IT_DRAWING;
+        }
+
+        // move control points
+        if ((ctx->id_type == IT_CRTL_PT1 || ctx->id_type == IT_CRTL_PT2) && ctx->active.id >= 0) {
+            int attached = graph_node_get(g, app->attached_node);
+            Vector2 new_ctrl_pos = Vector2Subtract(mouseWorldPos, graph_node_pos(g, attached));
+            float d              = Vector2Length(new_ctrl_pos);
+            if (d < 0.1f) {
+                new_ctrl_pos = (Vector2){ MIN_CONTROL_DISTANCE, 0 };
+            } else if (d < MIN_CONTROL_DISTANCE)
+                new_ctrl_pos = Vector2Scale(new_ctrl_pos, MIN_CONTROL_DISTANCE / d);
+            g->ctrl[ctx->id_type - IT_CRTL_PT1][ctx->active.id] = new_ctrl_pos;
+            geo_cache_touch_edge(&app->gc, ctx->active.id);
+        }
+
+        // a press on nothing starts a rubber band, adding to the selection with
+        // shift
+        if (in->left_pressed && ctx->active.id < 0 && ctx->id_type == IT_NONE
+                && CheckCollisionPointRec(in->mouse, app->graphics_area)) {
+            if (!in->shift_down) selection_clear(&app->sel);
+            ctx->id_type = IT_BAND;
+            ctx->active = (Handle){0};
+            app->band_start = mouseWorldPos;
+        }
+    } else
+
+    // add node, or an edge dragged from a node to another one
+    if (app->active_tool == TI_ADD_NODE) {
+        if (ctx->active.id < 0) {
+            ctx->focused = HANDLE_NONE;
+            ctx->id_type = -1;
+            ctx->active = HANDLE_NONE;
+        }
+        app->preview_node = mouseWorldPos;
+        bool in_area = CheckCollisionPointRec(in->mouse, app->graphics_area);
+        SpatialPick pick = app_pick(app, mouseWorldPos);
+        if (ctx->id_type == IT_DRAWING && ctx->active.id == 0) {
+            if(in->left_released) {
+                if (in_area && !app->loading) {
+                    int id = app_add_node(app, app->preview_node);
+                    TraceLog(LOG_DEBUG, "node %d placed at: %f, %f", id, app->preview_node.x,
+                            app->preview_node.y);
                 }
+                ctx->focused = HANDLE_NONE;
+                ctx->id_type = -1;
+                ctx->active = HANDLE_NONE;
             }
         }
+        if (ctx->id_type == IT_NEW_EDGE && ctx->active.id >= 0) {
+            if (in->left_released) {
+                if (in_area && pick.node >= 0 && !app->loading)
+                    app_add_edge(app, ctx->active.id, pick.node);
+                ctx->focused = HANDLE_NONE;
+                ctx->id_type = -1;
+                ctx->active = HANDLE_NONE;
+            }
+        }
+        if (in_area) {
+            if (pick.node >= 0) {
+                focus(ctx, IT_NODE, graph_node_handle(g, pick.node));
+            } else {
+                focus(ctx, IT_DRAWING, (Handle){0});
+            }
+        }
+        if (in->left_pressed && ctx->active.id < 0 && ctx->focused.id >= 0) {
+            if (ctx->id_type == IT_DRAWING) {
+                ctx->active = (Handle){0};
+            } else if (ctx->id_type == IT_NODE) {
+                ctx->active = ctx->focused;
+                ctx->id_type = IT_NEW_EDGE;
+            }
+        }
+    } else
+
+    // remove the node or the edge clicked, the history is cleared since the
+    // slots freed are reused
+    if (app->active_tool == TI_REM_NODE) {
+        ctx->focused = HANDLE_NONE;
+        ctx->id_type = -1;
+        ctx->active = HANDLE_NONE;
+        SpatialPick pick = app_pick(app, mouseWorldPos);
+        if (pick.node >= 0) {
+            focus(ctx, IT_NODE, graph_node_handle(g, pick.node));
+        } else if (pick.edge.type != IT_NONE) {
+            focus(ctx, pick.edge.type, item_handle(g, pick.edge.type, pick.edge.id));
+        }
+        if (in->left_pressed && ctx->focused.id >= 0 && !app->loading
+                && CheckCollisionPointRec(in->mouse, app->graphics_area)) {
+            if (ctx->id_type == IT_NODE) {
+                app_remove_node(app, ctx->focused.id);
+            } else {
+                app_remove_edge(app, ctx->focused.id);
+            }
+            journal_clear(&app->journal);
+            ctx->focused = HANDLE_NONE;
+            ctx->id_type = -1;
+        }
+    }
 
-        gui_locked = (ctx.id_type != -1 && ctx.active != -1);
+    app->gui_locked = (ctx->id_type != -1 && ctx->active.id >= 0);
 
+    // not in the middle of a drag
+    if (ctx->active.id < 0 && app_fragmented(app)) app_compact(app);
+    if (adjacency_stale(&app->adj)) adjacency_build(&app->adj, g);
+    prof_end(PZ_INPUT);
 
-        // ########################## DRAWING #########################################
-        ctx.zoom_coef = 1.0f/camera.zoom;
-        BeginDrawing();
+    if (app->active_tool == TI_LAYOUT) app_layout_step(app);
+    app->last_tool = app->active_tool;
 
-            ClearBackground(BACKGROUND_COLOR);
+    app_update_geometry(app);
+}
 
-            DrawLine(graphics_area.x, 0, graphics_area.x, graphics_area.height, BORDER_COLOR);
+// draw the edges and the neighbours of `node` over the graph, in O(degree)
+internal void app_draw_neighbors(GraphApp *app, int node)
+{
+    GraphCtx *ctx = &app->ctx;
+    Graph *g = &app->g;
+    int *incident = NULL;
+    adjacency_incident(&app->adj, g, node, &app->frame, &incident);
+
+    ctx->edge_override = graph_color(GC_NEIGHBOR);
+    draw_edges(incident, app->gc.geo, g, &app->batch, ctx);
+    ctx->edge_override = (Color){0};
+    for (size_t i = 0; i < da_size(incident); i++) {
+        int e = incident[i];
+        int other = (g->from[e] == node)? g->to[e] : g->from[e];
+        if (other != node) draw_node(graph_node_pos(g, other), graph_color(GC_NEIGHBOR), false,
+                false, ctx);
+    }
+}
 
-            BeginScissorMode(graphics_area.x, graphics_area.y, graphics_area.width, graphics_area.height);
-            // draw origin
-            Vector2 origin = GetWorldToScreen2D((Vector2){0}, camera);
-            DrawLine(origin.x - ORIGIN_LINE_LEN/2, origin.y, origin.x + ORIGIN_LINE_LEN/2, origin.y, ORIGIN_COLOR);
-            DrawLine(origin.x , origin.y - ORIGIN_LINE_LEN/2, origin.x, origin.y + ORIGIN_LINE_LEN/2, ORIGIN_COLOR);
-            DrawCircleLinesV(origin, ORIGIN_CIRCLE_RADIUS, ORIGIN_COLOR);
-            BeginMode2D(camera);
-                for(size_t i = 0; i < da_size(nodes); i++){
-                    draw_node(nodes[i], ctx.id_type == IT_NODE && ctx.focused == (int)i);
+// draw the origin, the nodes and the edges seen through `camera` in `area` of
+// the render target, without the items hovered or dragged: app_draw_overlay()
+// draws them over
+internal void app_draw_graph(GraphApp *app, Camera2D camera, Rectangle area)
+{
+    GraphCtx *ctx = &app->ctx;
+    Graph *g = &app->g;
+    FrameStats *stats = &app->stats;
+    int id_type = ctx->id_type;
+    ctx->id_type = IT_NONE;
+
+    // draw origin
+    Vector2 origin = GetWorldToScreen2D((Vector2){0}, camera);
+    DrawLine(origin.x - ORIGIN_LINE_LEN/2, origin.y, origin.x + ORIGIN_LINE_LEN/2, origin.y, ORIGIN_COLOR);
+    DrawLine(origin.x , origin.y - ORIGIN_LINE_LEN/2, origin.x, origin.y + ORIGIN_LINE_LEN/2, ORIGIN_COLOR);
+    DrawCircleLinesV(origin, ORIGIN_CIRCLE_RADIUS, ORIGIN_COLOR);
+    // world space region visible in the area
+    Vector2 view_min = GetScreenToWorld2D((Vector2){area.x, area.y}, camera);
+    Vector2 view_max = GetScreenToWorld2D((Vector2){area.x + area.width, area.y + area.height},
+            camera);
+    Rectangle view = {view_min.x, view_min.y, view_max.x - view_min.x, view_max.y - view_min.y};
+    stats->nodes_drawn = stats->nodes_culled = 0;
+    stats->edges_drawn = stats->edges_culled = 0;
+
+    BeginMode2D(camera);
+        prof_zone(PZ_DRAW_NODES) {
+            graph_foreach_node(g, i) {
+                if (!graph_node_alive(g, i)) continue;
+                Vector2 pos = graph_node_pos(g, i);
+                if (!CheckCollisionRecs(node_bounds(pos), view)) {
+                    stats->nodes_culled++;
+                    continue;
                 }
+                draw_node(pos, node_color(g, i), false, selection_has_node(&app->sel, i), ctx);
+                stats->nodes_drawn++;
+            }
+        }
 
-                for(size_t i = 0; i < da_size(edges); i++) {
-                    Edge edge = edges[i];
-                    draw_edge(edge_geo + i, i, edge.label, &ctx);
-                }
-                // DrawTextEx(ctx.font, "press C to toggle control points", (Vector2){10,10},
-                //         UI_FONT_SIZE, 2.0f, WHITE);
-                if (ctx.id_type == IT_DRAWING) {
-                    draw_node(preview_node, false);
-                }
-            EndMode2D();
-            EndScissorMode();
-
-            GuiToggle((Rectangle){10, 10, 80,30}, "Ctrl pts", &ctx.show_control_pts);
-            GuiToggleGroup((Rectangle){ 10, 50, 30, 30 }, "#21#\n#23#\n#28#\n#128#", &active_tool);
-            if (GuiButton((Rectangle){ 10, 180, 64, 30 }, "window")) {
-                memset(&nodewnd, 0, sizeof(nodewnd));
-                // nodewnd.active = true;
-                ctx.id_type = IT_WINDOW;
-                ctx.active = 0;
+        prof_begin(PZ_DRAW_EDGES);
+        // control points are drawn with a constant size on screen
+        Rectangle edge_view = view;
+        if (ctx->show_control_pts) {
+            float m = CONTROL_RADIUS * ctx->zoom_coef;
+            edge_view = (Rectangle){view.x - m, view.y - m, view.width + 2*m, view.height + 2*m};
+        }
+        app_cull_edges(app, edge_view);
+        stats->edges_drawn = da_size(app->visible_edges);
+        stats->edges_culled = graph_live_edges(g) - stats->edges_drawn;
+        draw_edges(app->visible_edges, app->gc.geo, g, &app->batch, ctx);
+        prof_end(PZ_DRAW_EDGES);
+    EndMode2D();
+    ctx->id_type = id_type;
+}
+
+// draw the item hovered or dragged over the graph, with the neighbours of a
+// node, and the node, edge or rectangle being drawn by the mouse
+internal void app_draw_overlay(GraphApp *app)
+{
+    GraphCtx *ctx = &app->ctx;
+    Graph *g = &app->g;
+    int id = ctx->focused.id;
+    if (id >= 0 && item_handle_valid(g, ctx->id_type, ctx->focused)) {
+        switch (ctx->id_type) {
+        case IT_NODE:
+            draw_node(graph_node_pos(g, id), node_color(g, id), true,
+                    selection_has_node(&app->sel, id), ctx);
+            app_draw_neighbors(app, id);
+            break;
+        case IT_EDGE:
+        case IT_LABEL:
+        case IT_CRTL_PT1:
+        case IT_CRTL_PT2: {
+            int *ids = NULL;
+            arena_da_append(&app->frame, ids, id);
+            draw_edges(ids, app->gc.geo, g, &app->batch, ctx);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    // DrawTextEx(ctx->font, "press C to toggle control points", (Vector2){10,10},
+    //         UI_FONT_SIZE, 2.0f, WHITE);
+    if (ctx->id_type == IT_DRAWING) {
+        draw_node(app->preview_node, graph_color(GC_NODE), false, false, ctx);
+    }
+    if (ctx->id_type == IT_NEW_EDGE) {
+        DrawLineEx(graph_node_pos(g, ctx->active.id), app->mouseWorldPos,
+                EDGE_THICKNESS*ctx->zoom_coef, graph_color(GC_EDGE_ACTIVE));
+    }
+    if (ctx->id_type == IT_BAND) {
+        Rectangle band = band_rect(app->band_start, app->mouseWorldPos);
+        DrawRectangleRec(band, graph_color(GC_SELECTION_BAND));
+        DrawRectangleLinesEx(band, ctx->zoom_coef, graph_color(GC_SELECTION_BAND_BORDER));
+    }
+}
+
+// what the graph drawn in the layer depends on, see layer.c
+internal LayerKey app_layer_key(GraphApp *app)
+{
+    LayerKey key = {app->camera.zoom, app->camera.rotation, app->gc.version, app->sel.version,
+            (int)app->graphics_area.width, (int)app->graphics_area.height,
+            app->ctx.show_control_pts, app->ctx.batched};
+    return key;
+}
+
+void app_draw(GraphApp *app)
+{
+    prof_begin(PZ_DRAW);
+    GraphCtx *ctx = &app->ctx;
+    Camera2D camera = app->camera;
+    Rectangle graphics_area = app->graphics_area;
+    FrameStats *stats = &app->stats;
+
+    ctx->zoom_coef = 1.0f/camera.zoom;
+    ctx->edge_colors = app->g.edge_color;
+    ctx->selected_edges = app->sel.edges;
+    // the layer is drawn again before the frame, out of the scissor mode of the
+    // graphics area
+    LayerKey key = app_layer_key(app);
+    bool composite = layer_stable(&app->layer, key) && ctx->cached_layer;
+    if (composite) {
+        if (!layer_fresh(&app->layer, key, camera, graphics_area)) {
+            Camera2D layer_camera = layer_begin(&app->layer, key, camera, graphics_area);
+            Texture2D t = app->layer.target.texture;
+            app_draw_graph(app, layer_camera, (Rectangle){0, 0, t.width, t.height});
+            layer_end();
+        }
+    }
+    BeginDrawing();
+
+        ClearBackground(BACKGROUND_COLOR);
+
+        DrawLine(graphics_area.x, 0, graphics_area.x, graphics_area.height, BORDER_COLOR);
+
+        BeginScissorMode(graphics_area.x, graphics_area.y, graphics_area.width, graphics_area.height);
+        if (composite) {
+            layer_draw(&app->layer, camera);
+        } else {
+            app_draw_graph(app, camera, graphics_area);
+        }
+        BeginMode2D(camera);
+            app_draw_overlay(app);
+        EndMode2D();
+        EndScissorMode();
+
+        prof_begin(PZ_GUI);
+        GuiToggle((Rectangle){10, 10, 80,30}, "Ctrl pts", &ctx->show_control_pts);
+        GuiToggle((Rectangle){10, 252, 80,30}, "Stats", &ctx->show_stats);
+        GuiToggle((Rectangle){10, 292, 80,30}, "Batch", &ctx->batched);
+        GuiToggle((Rectangle){10, 332, 80,30}, "Profile", &ctx->show_profile);
+        bool record_trace = ctx->record_trace;
+        GuiToggle((Rectangle){10, 372, 80,30}, "Trace", &ctx->record_trace);
+        if (GuiButton((Rectangle){10, 412, 80, 30}, "Layers")) app_hierarchy_layout(app);
+        if (GuiButton((Rectangle){10, 452, 80, 30}, "Color")) app_recolor_selection(app);
+        GuiToggle((Rectangle){10, 492, 80,30}, "Cache", &ctx->cached_layer);
+        if (ctx->record_trace != record_trace) {
+            if (ctx->record_trace) {
+                ctx->record_trace = prof_trace_start(PROF_TRACE_FILE);
+            } else {
+                prof_trace_stop();
             }
-            if (ctx.id_type == IT_WINDOW && ctx.active == 0) {
-                int active = GuiNodeProperty(&nodewnd, (Vector2){100,100});
-                if (! active) {
-                    ctx.id_type = -1;
-                    ctx.active = -1;
-                }
+        }
+        if (ctx->show_stats) {
+            stats->nodes_selected = app->sel.num_nodes;
+            stats->edges_selected = app->sel.num_edges;
+            stats->frame_bytes = arena_used(&app->frame);
+            stats->frame_high_water = app->frame.high_water;
+            stats->layer_redraws = app->layer.redraws;
+            draw_stats(stats, (Vector2){graphics_area.x + 10, graphics_area.height - 10});
+        }
+        if (ctx->show_profile) {
+            prof_draw_overlay((Vector2){graphics_area.x + 10, 10});
+        }
+        if (app->loading) {
+            float progress = loader_progress(&app->loader);
+            GuiProgressBar((Rectangle){graphics_area.x + 80, graphics_area.height - 30,
+                    graphics_area.width - 140, 20}, "importing",
+                    TextFormat("%d%%", (int)(100*progress)), &progress, 0.0f, 1.0f);
+        }
+        GuiToggleGroup((Rectangle){ 10, 50, 30, 30 }, "#21#\n#23#\n#28#\n#128#\n#131#",
+                &app->active_tool);
+        if (GuiButton((Rectangle){ 10, 212, 64, 30 }, "window")) {
+            memset(&app->nodewnd, 0, sizeof(app->nodewnd));
+            // nodewnd.active = true;
+            ctx->id_type = IT_WINDOW;
+            ctx->active = (Handle){0};
+        }
+        if (ctx->id_type == IT_WINDOW && ctx->active.id == 0) {
+            int active = GuiNodeProperty(&app->nodewnd, (Vector2){100,100});
+            if (! active) {
+                ctx->id_type = -1;
+                ctx->active = HANDLE_NONE;
             }
+        }
+        prof_end(PZ_GUI);
+
+    EndDrawing();
+    prof_end(PZ_DRAW);
+    prof_frame_end();
+}
+
+void app_free(GraphApp *app)
+{
+    prof_trace_stop();
+    if (app->loading) loader_end(&app->loader);
+    layout_free(&app->layout);
+    journal_free(&app->journal);
+    selection_free(&app->sel);
+    da_free(app->moved_ids);
+    da_free(app->node_map);
+    da_free(app->edge_map);
+    adjacency_free(&app->adj);
+    graph_free(&app->g);
+    geo_cache_free(&app->gc);
+    spatial_free(&app->si);
+    batch_free(&app->batch);
+    layer_free(&app->layer);
+    arena_free(&app->frame);
+    UnloadFont(app->ctx.font);
+}
 
-        EndDrawing();
+#ifndef GRAPHGUI_NO_MAIN
+int main(int argc, char **argv)
+{
+    // enable debug tracing
+    SetTraceLogLevel(LOG_DEBUG);
+
+    InitWindow(SCREEN_WIDTH, SCREEN_HEGHT, "graphgui");
+    SetExitKey(KEY_Q);
+    job_pool_init(&global_jobs, 0);
+    GraphApp app;
+    app_init(&app, SCREEN_WIDTH, SCREEN_HEGHT);
+
+    Graph *g = &app.g;
+    if (argc > 1) {
+        if (!app_open(&app, argv[1])) {
+            app_free(&app);
+            CloseWindow();
+            return 1;
+        }
+    } else {
+        graph_add_node(g, (Vector2){SCREEN_WIDTH/3, SCREEN_HEGHT/2});
+        graph_add_node(g, (Vector2){2*SCREEN_WIDTH/3, SCREEN_HEGHT/2});
+        graph_add_node(g, (Vector2){SCREEN_WIDTH/2, SCREEN_HEGHT*0.7f});
+
+        graph_add_edge(g, 0, 1, (Vector2){ 100, -90}, (Vector2){0, -120}, (Vector2){0, 0}, "hello");
+        graph_add_edge(g, 1, 0, (Vector2){ -80, -90}, (Vector2){130, 0}, (Vector2){0, 0}, "   ");
+        graph_add_edge(g, 0, 2, (Vector2){ 0, 80}, (Vector2){-75, 0}, (Vector2){0, 0}, "world");
+        graph_add_edge(g, 1, 2, (Vector2){ 0, 100}, (Vector2){70, 60}, (Vector2){0, 0}, "!");
+        graph_add_edge(g, 1, 1, (Vector2){ 90, -50}, (Vector2){90, 50}, (Vector2){0, 0}, "repeat");
+        app_sync_graph(&app);
+        app_update_geometry(&app);
     }
 
-    da_free(nodes);
-    da_free(edges);
-    da_free(edge_geo);
+    SetTargetFPS(30);
+
+    while(!WindowShouldClose()) {
+        app_begin_frame(&app);
+        if (IsFileDropped()) {
+            FilePathList files = LoadDroppedFiles();
+            app_open(&app, files.paths[0]);
+            UnloadDroppedFiles(files);
+        }
+        FrameInput in = poll_input();
+        app_update(&app, &in);
+        app_draw(&app);
+    }
 
-    UnloadFont(ctx.font);
+    app_free(&app);
+    job_pool_free(&global_jobs);
     CloseWindow();
     return 0;
 }
+#endif // GRAPHGUI_NO_MAIN
+
+Color edge_color(int id, GraphCtx *ctx)
+{
+    if (ctx->edge_override.a)
+        return ctx->edge_override;
+    else if(ctx->id_type == IT_LABEL && ctx->active.id == id)
+        return graph_color(GC_EDGE_ACTIVE);
+    else if (ctx->id_type == IT_EDGE && ctx->focused.id == id)
+        return graph_color(GC_EDGE_ACTIVE);
+    else if (ctx->selected_edges && bitset_get(ctx->selected_edges, id))
+        return graph_color(GC_SELECTED);
+    else if (ctx->edge_colors && ctx->edge_colors[id].a)
+        return ctx->edge_colors[id];
+    else
+        return graph_color(GC_EDGE);
+}
 
 void draw_edge(EdgeGeo *geo, int id, const char *label, GraphCtx *ctx)
 {
     // DrawSplineSegmentBezierCubic(bs, c1a, c2a, be, 4.0f, graph_color(GC_EDGE));
-    Color edge_color;
-    if(ctx->id_type == IT_LABEL && ctx->active == id)
-        edge_color = graph_color(GC_EDGE_ACTIVE);
+    Color color = edge_color(id, ctx);
+
+    // DrawSplineBezierCubic always uses the same number of segments, fall back
+    // to a line when the curve is a few pixels long
+    if (lod_curve_segments(geo, ctx->zoom_coef, 2) > 1)
+        DrawSplineBezierCubic(geo->points, 4, EDGE_THICKNESS, color);
     else
-        edge_color = graph_color(GC_EDGE);
+        DrawLineEx(geo->points[EI_BS], geo->points[EI_BE], EDGE_THICKNESS, color);
+
+    if (lod_show_labels(ctx->zoom_coef)) {
+        Vector2 lpos = geo->points[EI_LPOS];
+        Rectangle rec = label_rect(geo);
+        if (ctx->id_type == IT_LABEL && ctx->focused.id == id ) DrawRectangleRec(rec,
+                graph_color(GC_LABEL_BACKGROUND_HOVER));
+        DrawTextEx(ctx->font, label, lpos, UI_FONT_SIZE, LABEL_SPACING, graph_color(GC_LABEL));
+    }
 
-    DrawSplineBezierCubic(geo->points, 4, 4.0f, edge_color);
+    // DrawTriangle(tip, b2, b1, graph_color(GC_EDGE));
+    DrawTriangleFan(geo->points + EI_TIP, 3, color);
 
-    Vector2 lpos = geo->points[EI_LPOS];
-    Rectangle rec = label_rect(geo);
-    if (ctx->id_type == IT_LABEL && ctx->focused == id ) DrawRectangleRec(rec,
-            graph_color(GC_LABEL_BACKGROUND_HOVER));
-    DrawTextEx(ctx->font, label, lpos, UI_FONT_SIZE, 2.0f, graph_color(GC_LABEL));
+    draw_edge_controls(geo, id, ctx);
+}
 
-    // DrawTriangle(tip, b2, b1, graph_color(GC_EDGE));
-    DrawTriangleFan(geo->points + EI_TIP, 3, edge_color);
+// draw the edges listed in `ids`, batched or one by one according to ctx->batched
+void draw_edges(int *ids, EdgeGeo *geo, Graph *g, EdgeBatch *batch, GraphCtx *ctx)
+{
+    if (ctx->batched) {
+        batch_begin(batch);
+        for (size_t k = 0; k < da_size(ids); k++) {
+            int i = ids[k];
+            batch_edge(batch, geo + i, i, ctx);
+        }
+        batch_flush(batch);
+        if (lod_show_labels(ctx->zoom_coef)) {
+            for (size_t k = 0; k < da_size(ids); k++) {
+                int i = ids[k];
+                DrawTextEx(ctx->font, graph_label(g, i), geo[i].points[EI_LPOS], UI_FONT_SIZE,
+                        LABEL_SPACING, graph_color(GC_LABEL));
+            }
+        }
+        for (size_t k = 0; k < da_size(ids); k++) {
+            int i = ids[k];
+            draw_edge_controls(geo + i, i, ctx);
+        }
+    } else {
+        for (size_t k = 0; k < da_size(ids); k++) {
+            int i = ids[k];
+            draw_edge(geo + i, i, graph_label(g, i), ctx);
+        }
+    }
+}
 
+void draw_edge_controls(EdgeGeo *geo, int id, GraphCtx *ctx)
+{
     if (ctx->show_control_pts) {
         float ctrl_radius = CONTROL_RADIUS * ctx->zoom_coef;
         Vector2 bs = geo->points[EI_BS];
@@ -535,15 +1620,16 @@ void draw_edge(EdgeGeo *geo, int id, const char *label, GraphCtx *ctx)
         DrawLineV(bs, c1a, graph_color(GC_CONTROL_LINE));
         DrawLineV(be, c2a, graph_color(GC_CONTROL_LINE));
 
-        DrawCircleV(c1a, ctrl_radius, (ctx->id_type == IT_CRTL_PT1 && id == ctx->focused)?
+        DrawCircleV(c1a, ctrl_radius, (ctx->id_type == IT_CRTL_PT1 && id == ctx->focused.id)?
                 graph_color(GC_CONTROL_SELECTED):graph_color(GC_CONTROL));
-        DrawCircleV(c2a, ctrl_radius, (ctx->id_type == IT_CRTL_PT2 && id == ctx->focused)?
+        DrawCircleV(c2a, ctrl_radius, (ctx->id_type == IT_CRTL_PT2 && id == ctx->focused.id)?
                 graph_color(GC_CONTROL_SELECTED):graph_color(GC_CONTROL));
     }
 }
 
+// `lsize` is the size of the label text
 void compute_edge_geo(EdgeGeo *geo, Vector2 n1, Vector2 n2, Vector2 c1, Vector2 c2, Vector2 loffset,
-        const char *label, GraphCtx *ctx)
+        Vector2 lsize)
 {
     Vector2 bs = Vector2Add(n1, Vector2Scale(Vector2Normalize(c1), NODE_RADIUS));
     Vector2 normal_end = Vector2Normalize(c2);
@@ -557,7 +1643,6 @@ void compute_edge_geo(EdgeGeo *geo, Vector2 n1, Vector2 n2, Vector2 c1, Vector2
     geo->points[EI_BE] = be;
 
     Vector2 lpos = GetSplinePointBezierCubic(bs, c1a, c2a, be, 0.5f);
-    Vector2 lsize = MeasureTextEx(ctx->font, label, UI_FONT_SIZE, 2.0f);
     lpos = Vector2Add(lpos, loffset);
 
     geo->points[EI_LPOS]  = lpos;
@@ -571,4 +1656,40 @@ void compute_edge_geo(EdgeGeo *geo, Vector2 n1, Vector2 n2, Vector2 c1, Vector2
     geo->points[EI_TIP] = tip;
     geo->points[EI_B1]  = b1;
     geo->points[EI_B2]  = b2;
+
+    Vector2 bbmin = Vector2Add(lpos, lsize);
+    Vector2 bbmax = bbmin;
+    for (int i = EI_BS; i <= EI_LPOS; i++) {
+        Vector2 p = geo->points[i];
+        if (p.x < bbmin.x) bbmin.x = p.x;
+        if (p.y < bbmin.y) bbmin.y = p.y;
+        if (p.x > bbmax.x) bbmax.x = p.x;
+        if (p.y > bbmax.y) bbmax.y = p.y;
+    }
+    float half_thick = EDGE_THICKNESS/2;
+    geo->points[EI_BB_MIN] = Vector2SubtractValue(bbmin, half_thick);
+    geo->points[EI_BB_MAX] = Vector2AddValue(bbmax, half_thick);
+}
+
+void draw_stats(FrameStats *stats, Vector2 bottom_left)
+{
+    int font_size = 10;
+    int num_lines = 6;
+    int x = bottom_left.x;
+    int y = bottom_left.y - num_lines*font_size;
+    DrawText(TextFormat("edges rebuilt: %d", stats->edges_rebuilt), x, y, font_size, LIGHTGRAY);
+    y += font_size;
+    DrawText(TextFormat("nodes drawn/culled: %d/%d", stats->nodes_drawn, stats->nodes_culled),
+            x, y, font_size, LIGHTGRAY);
+    y += font_size;
+    DrawText(TextFormat("edges drawn/culled: %d/%d", stats->edges_drawn, stats->edges_culled),
+            x, y, font_size, LIGHTGRAY);
+    y += font_size;
+    DrawText(TextFormat("nodes/edges selected: %d/%d", stats->nodes_selected,
+            stats->edges_selected), x, y, font_size, LIGHTGRAY);
+    y += font_size;
+    DrawText(TextFormat("frame arena: %zu KB, at most %zu KB", stats->frame_bytes/1024,
+            stats->frame_high_water/1024), x, y, font_size, LIGHTGRAY);
+    y += font_size;
+    DrawText(TextFormat("layer redraws: %d", stats->layer_redraws), x, y, font_size, LIGHTGRAY);
 }
\ No newline at end of file
@@ -0,0 +1,356 @@
+// Graph file
+//
+// binary format whose sections are the arrays of the Graph store, so a file is
+// loaded by mapping it in memory and pointing the arrays into the mapping: there
+// is no parsing and the arrays aren't copied. the file isn't trusted, so the
+// load still reads the node ids and the label of every edge and the offsets of
+// the labels to check them, and adds every label to the table of the graph,
+// which is O(E + L). the positions, control points and colors are only read
+// when they are first touched, though the app then reads them all to build its
+// indexes, see app_set_graph().
+//
+//     GraphFileHeader
+//     GraphFileSection[num_sections]
+//     sections, each one a Dynamic_Array_Header followed by the items
+//
+// every section is stored as a dynamic array (see commons.h) flagged as
+// DA_EXTERNAL: editing the graph writes to private copy-on-write pages, and
+// arrays that grow are moved to the heap. the labels are a blob of NUL
+// terminated strings with the offset and the hash of each one, the edges store
+// the index of their label.
+//
+// sections added after the first version are optional, files without them load
+// with default values.
+//
+// numbers are stored in the byte order of the machine, and the layout of the
+// headers is the one of 64 bit targets.
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GRAPH_FILE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define GRAPH_FILE_MAGIC "GRPH"
+#define GRAPH_FILE_VERSION 1
+#define GRAPH_FILE_ALIGN 16
+
+enum GraphSection {
+    GS_NODE_X,
+    GS_NODE_Y,
+    GS_EDGE_FROM,
+    GS_EDGE_TO,
+    GS_EDGE_CTRL1,
+    GS_EDGE_CTRL2,
+    GS_EDGE_LOFFSET,
+    GS_EDGE_LABEL,
+    GS_LABEL_OFFSET,    // num_labels + 1 offsets in GS_STRINGS
+    GS_LABEL_HASH,
+    GS_STRINGS,
+    GS_NODE_COLOR,      // optional
+    GS_EDGE_COLOR,      // optional
+
+    GS_NUM_SECTIONS
+};
+
+typedef struct GraphFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t num_sections;
+    uint32_t reserved;
+    uint64_t num_nodes;
+    uint64_t num_edges;
+    uint64_t num_labels;
+} GraphFileHeader;
+
+typedef struct GraphFileSection {
+    uint32_t id;            // enum GraphSection, unknown ids are skipped
+    uint32_t item_size;
+    uint64_t offset;        // of the Dynamic_Array_Header, from the start of the file
+    uint64_t count;
+} GraphFileSection;
+
+static_assert(sizeof(GraphFileHeader) % 8 == 0);
+static_assert(sizeof(GraphFileSection) % 8 == 0);
+static_assert(sizeof(Dynamic_Array_Header) % 8 == 0);
+
+internal size_t graph_file_align(size_t offset)
+{
+    return (offset + GRAPH_FILE_ALIGN - 1) & ~(size_t)(GRAPH_FILE_ALIGN - 1);
+}
+
+void graph_file_unmap(void *mapped, size_t size)
+{
+    if (!mapped) return;
+#ifdef GRAPH_FILE_MMAP
+    munmap(mapped, size);
+#else
+    UnloadFileData(mapped);
+#endif
+}
+
+internal void *graph_file_map(const char *path, size_t *size)
+{
+#ifdef GRAPH_FILE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    // private and writable: edits go to copy-on-write pages, never to the file
+    void *data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    *size = st.st_size;
+    return data;
+#else
+    int data_size = 0;
+    void *data = LoadFileData(path, &data_size);
+    *size = data_size;
+    return data;
+#endif
+}
+
+internal size_t graph_file_write_section(FILE *f, GraphFileSection *sec, enum GraphSection id,
+        size_t offset, const void *items, size_t count, size_t item_size)
+{
+    static const uint8_t zeros[GRAPH_FILE_ALIGN] = {0};
+    offset = graph_file_align(offset);
+    fwrite(zeros, 1, offset - ftell(f), f);
+
+    *sec = (GraphFileSection){.id = id, .item_size = item_size, .offset = offset, .count = count};
+    Dynamic_Array_Header hdr = {.cap = count, .size = count, .flags = DA_EXTERNAL};
+    fwrite(&hdr, sizeof(hdr), 1, f);
+    if (count) fwrite(items, item_size, count, f);
+    return offset + sizeof(hdr) + count*item_size;
+}
+
+// the graph is written to `path`.tmp, then renamed over `path`: a graph loaded
+// from `path` still points into the mapping of the old file, which truncating it
+// would cut under the arrays being written
+bool graph_save(Graph *g, const char *path)
+{
+    assert(!graph_has_free_slots(g) && "compact the graph first");
+    size_t path_len = strlen(path);
+    char *tmp_path = malloc(path_len + sizeof(".tmp"));
+    memcpy(tmp_path, path, path_len);
+    memcpy(tmp_path + path_len, ".tmp", sizeof(".tmp"));
+    FILE *f = fopen(tmp_path, "wb");
+    if (!f) {
+        TraceLog(LOG_WARNING, "GRAPH: could not open %s for writing", tmp_path);
+        free(tmp_path);
+        return false;
+    }
+
+    LabelTable *lt = &g->labels;
+    size_t num_labels = da_size(lt->entries);
+    uint64_t *label_offset = malloc((num_labels + 1)*sizeof(*label_offset));
+    uint32_t *label_hash = malloc((num_labels + 1)*sizeof(*label_hash));
+    uint64_t strings_size = 0;
+    for (size_t i = 0; i < num_labels; i++) {
+        label_offset[i] = strings_size;
+        label_hash[i] = lt->entries[i].hash;
+        strings_size += lt->entries[i].len + 1;
+    }
+    label_offset[num_labels] = strings_size;
+
+    GraphFileHeader header = {
+        .magic = GRAPH_FILE_MAGIC,
+        .version = GRAPH_FILE_VERSION,
+        .num_sections = GS_NUM_SECTIONS,
+        .num_nodes = graph_num_nodes(g),
+        .num_edges = graph_num_edges(g),
+        .num_labels = num_labels,
+    };
+    GraphFileSection sections[GS_NUM_SECTIONS] = {0};
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(sections, sizeof(sections), 1, f);   // placeholder, rewritten at the end
+
+    size_t n = header.num_nodes;
+    size_t e = header.num_edges;
+    size_t off = sizeof(header) + sizeof(sections);
+    off = graph_file_write_section(f, sections + GS_NODE_X, GS_NODE_X, off, g->x, n, sizeof(float));
+    off = graph_file_write_section(f, sections + GS_NODE_Y, GS_NODE_Y, off, g->y, n, sizeof(float));
+    off = graph_file_write_section(f, sections + GS_EDGE_FROM, GS_EDGE_FROM, off, g->from, e,
+            sizeof(int));
+    off = graph_file_write_section(f, sections + GS_EDGE_TO, GS_EDGE_TO, off, g->to, e,
+            sizeof(int));
+    off = graph_file_write_section(f, sections + GS_EDGE_CTRL1, GS_EDGE_CTRL1, off, g->ctrl[0], e,
+            sizeof(Vector2));
+    off = graph_file_write_section(f, sections + GS_EDGE_CTRL2, GS_EDGE_CTRL2, off, g->ctrl[1], e,
+            sizeof(Vector2));
+    off = graph_file_write_section(f, sections + GS_EDGE_LOFFSET, GS_EDGE_LOFFSET, off,
+            g->loffset, e, sizeof(Vector2));
+    off = graph_file_write_section(f, sections + GS_EDGE_LABEL, GS_EDGE_LABEL, off, g->label, e,
+            sizeof(int));
+    off = graph_file_write_section(f, sections + GS_LABEL_OFFSET, GS_LABEL_OFFSET, off,
+            label_offset, num_labels + 1, sizeof(*label_offset));
+    off = graph_file_write_section(f, sections + GS_LABEL_HASH, GS_LABEL_HASH, off, label_hash,
+            num_labels, sizeof(*label_hash));
+
+    off = graph_file_write_section(f, sections + GS_NODE_COLOR, GS_NODE_COLOR, off,
+            g->node_color, n, sizeof(Color));
+    off = graph_file_write_section(f, sections + GS_EDGE_COLOR, GS_EDGE_COLOR, off,
+            g->edge_color, e, sizeof(Color));
+
+    // the string blob is written label by label, last
+    off = graph_file_write_section(f, sections + GS_STRINGS, GS_STRINGS, off, NULL, 0, 1);
+    sections[GS_STRINGS].count = strings_size;
+    for (size_t i = 0; i < num_labels; i++)
+        fwrite(lt->entries[i].str, 1, lt->entries[i].len + 1, f);
+    Dynamic_Array_Header strings_hdr = {.cap = strings_size, .size = strings_size,
+            .flags = DA_EXTERNAL};
+    fseek(f, sections[GS_STRINGS].offset, SEEK_SET);
+    fwrite(&strings_hdr, sizeof(strings_hdr), 1, f);
+
+    fseek(f, sizeof(header), SEEK_SET);
+    fwrite(sections, sizeof(sections), 1, f);
+
+    bool ok = !ferror(f);
+    ok = (fclose(f) == 0) && ok;
+    free(label_offset);
+    free(label_hash);
+#ifndef GRAPH_FILE_MMAP
+    // rename() doesn't replace an existing file everywhere, and without the
+    // mapping nothing points into the old one
+    if (ok) remove(path);
+#endif
+    ok = ok && rename(tmp_path, path) == 0;
+    if (!ok) {
+        TraceLog(LOG_WARNING, "GRAPH: error writing %s", path);
+        remove(tmp_path);
+    }
+    free(tmp_path);
+    return ok;
+}
+
+// pointer to the dynamic array of a section, or NULL when it does not match the
+// header or does not fit in the file
+internal void *graph_file_section(uint8_t *data, size_t size, GraphFileSection *sec,
+        uint64_t count, uint32_t item_size)
+{
+    if (sec->item_size != item_size || sec->count != count) return NULL;
+    if (sec->offset % 8 || sec->offset > size - sizeof(Dynamic_Array_Header)) return NULL;
+    if ((size - sec->offset - sizeof(Dynamic_Array_Header))/item_size < count) return NULL;
+
+    Dynamic_Array_Header *hdr = (Dynamic_Array_Header *)(data + sec->offset);
+    if (hdr->size != count || hdr->cap != count || hdr->flags != DA_EXTERNAL) return NULL;
+    return hdr + 1;
+}
+
+// replace the content of the empty graph `g` with the graph stored at `path`
+bool graph_load(Graph *g, const char *path)
+{
+    assert(graph_num_nodes(g) == 0 && graph_num_edges(g) == 0);
+    assert(da_size(g->labels.entries) == 0);
+
+    size_t size = 0;
+    uint8_t *data = graph_file_map(path, &size);
+    if (!data) {
+        TraceLog(LOG_WARNING, "GRAPH: could not open %s", path);
+        return false;
+    }
+
+    const char *error = NULL;
+    GraphFileHeader *header = (GraphFileHeader *)data;
+    if (size < sizeof(*header) + sizeof(Dynamic_Array_Header) || memcmp(header->magic, GRAPH_FILE_MAGIC, 4) != 0) {
+        error = "not a graph file";
+    } else if (header->version != GRAPH_FILE_VERSION) {
+        error = "unsupported version";
+    } else if ((size - sizeof(*header))/sizeof(GraphFileSection) < header->num_sections) {
+        error = "truncated section table";
+    } else if (header->num_nodes > INT32_MAX || header->num_edges > INT32_MAX
+            || header->num_labels > INT32_MAX) {
+        error = "graph too big";
+    }
+    if (error) goto fail;
+
+    uint64_t n = header->num_nodes;
+    uint64_t e = header->num_edges;
+    uint64_t l = header->num_labels;
+    struct {
+        void **array;
+        uint64_t count;
+        uint32_t item_size;
+    } expected[GS_NUM_SECTIONS] = {
+        [GS_NODE_X]       = {(void **)&g->x,       n, sizeof(float)},
+        [GS_NODE_Y]       = {(void **)&g->y,       n, sizeof(float)},
+        [GS_EDGE_FROM]    = {(void **)&g->from,    e, sizeof(int)},
+        [GS_EDGE_TO]      = {(void **)&g->to,      e, sizeof(int)},
+        [GS_EDGE_CTRL1]   = {(void **)&g->ctrl[0], e, sizeof(Vector2)},
+        [GS_EDGE_CTRL2]   = {(void **)&g->ctrl[1], e, sizeof(Vector2)},
+        [GS_EDGE_LOFFSET] = {(void **)&g->loffset, e, sizeof(Vector2)},
+        [GS_EDGE_LABEL]   = {(void **)&g->label,   e, sizeof(int)},
+        [GS_LABEL_OFFSET] = {NULL,                 l + 1, sizeof(uint64_t)},
+        [GS_LABEL_HASH]   = {NULL,                 l, sizeof(uint32_t)},
+        [GS_STRINGS]      = {NULL,                 0, 1},
+        [GS_NODE_COLOR]   = {(void **)&g->node_color, n, sizeof(Color)},
+        [GS_EDGE_COLOR]   = {(void **)&g->edge_color, e, sizeof(Color)},
+    };
+    void *found[GS_NUM_SECTIONS] = {0};
+
+    GraphFileSection *sections = (GraphFileSection *)(header + 1);
+    for (uint32_t i = 0; i < header->num_sections; i++) {
+        GraphFileSection *sec = sections + i;
+        if (sec->id >= GS_NUM_SECTIONS) continue;
+        // the size of the string blob is known only from its section
+        uint64_t count = (sec->id == GS_STRINGS)? sec->count : expected[sec->id].count;
+        found[sec->id] = graph_file_section(data, size, sec, count, expected[sec->id].item_size);
+        if (!found[sec->id]) {
+            error = "corrupted section";
+            goto fail;
+        }
+    }
+    for (int i = 0; i < GS_NUM_SECTIONS; i++) {
+        if (!found[i] && i != GS_NODE_COLOR && i != GS_EDGE_COLOR) {
+            error = "missing section";
+            goto fail;
+        }
+    }
+
+    // the rest of the code trusts ids, check them once here
+    int *from = found[GS_EDGE_FROM];
+    int *to = found[GS_EDGE_TO];
+    int *label = found[GS_EDGE_LABEL];
+    for (uint64_t i = 0; i < e; i++) {
+        if ((uint64_t)from[i] >= n || (uint64_t)to[i] >= n || (uint64_t)label[i] >= l) {
+            error = "edge with invalid node or label";
+            goto fail;
+        }
+    }
+    uint64_t *label_offset = found[GS_LABEL_OFFSET];
+    uint32_t *label_hash = found[GS_LABEL_HASH];
+    char *strings = found[GS_STRINGS];
+    uint64_t strings_size = da_size(strings);
+    for (uint64_t i = 0; i < l; i++) {
+        uint64_t start = label_offset[i];
+        uint64_t end = label_offset[i + 1];
+        if (start >= end || end > strings_size || strings[end - 1] != '\0') {
+            error = "invalid label";
+            goto fail;
+        }
+    }
+
+    for (int i = 0; i < GS_NUM_SECTIONS; i++) {
+        if (expected[i].array) *expected[i].array = found[i];
+    }
+    if (!g->node_color) graph_append_zeros(g->node_color, n);
+    if (!g->edge_color) graph_append_zeros(g->edge_color, e);
+    for (uint64_t i = 0; i < l; i++) {
+        uint64_t start = label_offset[i];
+        label_add_external(&g->labels, strings + start, label_offset[i + 1] - start - 1,
+                label_hash[i]);
+    }
+    g->mapped = data;
+    g->mapped_size = size;
+    return true;
+
+fail:
+    TraceLog(LOG_WARNING, "GRAPH: could not load %s: %s", path, error);
+    graph_file_unmap(data, size);
+    return false;
+}
@@ -0,0 +1,355 @@
+// Graph store
+//
+// structure of arrays: every field of nodes and edges lives in its own dynamic
+// array (see commons.h), indexed by node or edge id. a pass over the edges only
+// streams the fields it reads, and labels are kept apart in an interned table
+// that the edges refer to by index.
+//
+// removing a node or an edge is O(1): its slot is marked free, so the ids of the
+// other items don't change, and the next item added takes it back. a removed
+// edge has `from` set to -1 and a removed node its bit set in `dead_nodes`.
+// graph_compact() drops the free slots in one pass, remapping the ids, so a
+// graph edited for a long time doesn't stay full of holes.
+//
+// a Handle is an id with the generation of its slot, bumped every time the slot
+// is freed: graph_node_get() and graph_edge_get() tell in O(1) whether the item
+// a handle was taken from is still there, even when its slot was reused since.
+// a compaction moves the items and starts the generations over, the handles
+// kept have to be remapped like the ids.
+
+typedef struct Graph {
+    // nodes
+    float *x;
+    float *y;
+    Color *node_color;  // {0} for the color of the theme
+
+    // edges
+    int *from;
+    int *to;
+    Vector2 *ctrl[2];   // control points, relative to the `from` and `to` nodes
+    Vector2 *loffset;
+    int *label;         // id in `labels`
+    Color *edge_color;
+
+    LabelTable labels;
+
+    // free slots, reused last removed first
+    int *free_nodes;
+    int *free_edges;
+    uint64_t *dead_nodes;   // bitset, may be shorter than the nodes
+    uint32_t *node_gen;     // generation of the slots, may be shorter, 0 past the end
+    uint32_t *edge_gen;
+
+    // file the arrays are mapped from, see graphfile.c
+    void *mapped;
+    size_t mapped_size;
+} Graph;
+
+#define graph_num_nodes(g) ((int)da_size((g)->x))
+#define graph_num_edges(g) ((int)da_size((g)->from))
+
+#define graph_foreach_node(g, i) for (int i = 0; i < graph_num_nodes(g); i++)
+#define graph_foreach_edge(g, i) for (int i = 0; i < graph_num_edges(g); i++)
+
+// ids in use, without the free slots
+#define graph_live_nodes(g) (graph_num_nodes(g) - (int)da_size((g)->free_nodes))
+#define graph_live_edges(g) (graph_num_edges(g) - (int)da_size((g)->free_edges))
+#define graph_has_free_slots(g) (da_size((g)->free_nodes) || da_size((g)->free_edges))
+
+inline internal bool graph_node_alive(Graph *g, int node)
+{
+    return ((size_t)node >> 6) >= da_size(g->dead_nodes) || !bitset_get(g->dead_nodes, node);
+}
+
+inline internal bool graph_edge_alive(Graph *g, int edge)
+{
+    return g->from[edge] >= 0;
+}
+
+inline internal uint32_t graph_slot_gen(uint32_t *gens, int id)
+{
+    return ((size_t)id < da_size(gens))? gens[id] : 0;
+}
+
+inline internal Handle graph_node_handle(Graph *g, int node)
+{
+    Handle result = {node, graph_slot_gen(g->node_gen, node)};
+    return result;
+}
+
+inline internal Handle graph_edge_handle(Graph *g, int edge)
+{
+    Handle result = {edge, graph_slot_gen(g->edge_gen, edge)};
+    return result;
+}
+
+// the node of `h`, -1 for none or when it was removed since the handle was taken
+inline internal int graph_node_get(Graph *g, Handle h)
+{
+    if ((unsigned)h.id >= (unsigned)graph_num_nodes(g)) return -1;
+    return (graph_slot_gen(g->node_gen, h.id) == h.gen)? h.id : -1;
+}
+
+// the edge of `h`, see graph_node_get()
+inline internal int graph_edge_get(Graph *g, Handle h)
+{
+    if ((unsigned)h.id >= (unsigned)graph_num_edges(g)) return -1;
+    return (graph_slot_gen(g->edge_gen, h.id) == h.gen)? h.id : -1;
+}
+
+inline internal Vector2 graph_node_pos(Graph *g, int node)
+{
+    Vector2 result = {g->x[node], g->y[node]};
+    return result;
+}
+
+inline internal void graph_set_node_pos(Graph *g, int node, Vector2 pos)
+{
+    g->x[node] = pos.x;
+    g->y[node] = pos.y;
+}
+
+// append `n` items set to 0
+#define graph_append_zeros(da, n)                                             \
+    do {                                                                      \
+        da_reserve(da, n);                                                    \
+        memset((da) + da_size(da), 0, (n)*sizeof(*(da)));                     \
+        da_size(da) += (n);                                                   \
+    } while(0)
+
+// shrink `da` to its size when it uses less than half of its capacity
+#define graph_shrink_sparse(da)                                               \
+    do {                                                                      \
+        if (2*da_size(da) < da_cap(da)) da_shrink_to_fit(da);                 \
+    } while(0)
+
+inline internal const char *graph_label(Graph *g, int edge)
+{
+    return label_str(&g->labels, g->label[edge]);
+}
+
+// control points of a new edge between nodes at `p1` and `p2`: a gentle curve
+// bending to the left, or a loop when the edge goes back to its node
+void edge_default_ctrl(Vector2 p1, Vector2 p2, bool loop, Vector2 *c1, Vector2 *c2)
+{
+    *c1 = (Vector2){90, -50};
+    *c2 = (Vector2){90, 50};
+    if (loop) return;
+    Vector2 d = Vector2Subtract(p2, p1);
+    float len = Vector2Length(d);
+    Vector2 c = (len < 0.1f)? (Vector2){MIN_CONTROL_DISTANCE, 0} : Vector2Scale(d, 1.0f/3);
+    if (len >= 0.1f && len/3 < MIN_CONTROL_DISTANCE)
+        c = Vector2Scale(d, MIN_CONTROL_DISTANCE/len);
+    // bend to the left of the direction, so a -> b and b -> a don't overlap
+    Vector2 bend = Vector2Scale(Vector2CounterRight(Vector2Normalize(c)), 0.2f*Vector2Length(c));
+    *c1 = Vector2Add(c, bend);
+    *c2 = Vector2Add(Vector2Negate(c), bend);
+}
+
+// add a node in the last free slot, or at the end
+int graph_add_node(Graph *g, Vector2 pos)
+{
+    if (da_size(g->free_nodes)) {
+        int id = g->free_nodes[da_size(g->free_nodes) - 1];
+        da_pop(g->free_nodes);
+        bitset_unset(g->dead_nodes, id);
+        graph_set_node_pos(g, id, pos);
+        g->node_color[id] = (Color){0};
+        return id;
+    }
+    da_append(g->x, pos.x);
+    da_append(g->y, pos.y);
+    da_append(g->node_color, (Color){0});
+    return graph_num_nodes(g) - 1;
+}
+
+int graph_add_edge(Graph *g, int from, int to, Vector2 c1, Vector2 c2, Vector2 loffset,
+        const char *label)
+{
+    assert(from >= 0 && from < graph_num_nodes(g) && graph_node_alive(g, from));
+    assert(to >= 0 && to < graph_num_nodes(g) && graph_node_alive(g, to));
+    if (da_size(g->free_edges)) {
+        int id = g->free_edges[da_size(g->free_edges) - 1];
+        da_pop(g->free_edges);
+        g->from[id]    = from;
+        g->to[id]      = to;
+        g->ctrl[0][id] = c1;
+        g->ctrl[1][id] = c2;
+        g->loffset[id] = loffset;
+        g->label[id]   = label_intern(&g->labels, label);
+        g->edge_color[id] = (Color){0};
+        return id;
+    }
+    da_append(g->from, from);
+    da_append(g->to, to);
+    da_append(g->ctrl[0], c1);
+    da_append(g->ctrl[1], c2);
+    da_append(g->loffset, loffset);
+    da_append(g->label, label_intern(&g->labels, label));
+    da_append(g->edge_color, (Color){0});
+    return graph_num_edges(g) - 1;
+}
+
+// append `n` nodes after the free slots, returns the id of the first one
+int graph_add_nodes(Graph *g, float *x, float *y, int n)
+{
+    int first = graph_num_nodes(g);
+    if (n == 0) return first;
+    da_append_many(g->x, x, n);
+    da_append_many(g->y, y, n);
+    graph_append_zeros(g->node_color, n);
+    return first;
+}
+
+// append `n` edges whose labels are already interned in g->labels, returns the
+// id of the first one
+int graph_add_edges(Graph *g, int *from, int *to, Vector2 *c1, Vector2 *c2, Vector2 *loffset,
+        int *label, int n)
+{
+    int first = graph_num_edges(g);
+    if (n == 0) return first;
+    da_append_many(g->from, from, n);
+    da_append_many(g->to, to, n);
+    da_append_many(g->ctrl[0], c1, n);
+    da_append_many(g->ctrl[1], c2, n);
+    da_append_many(g->loffset, loffset, n);
+    da_append_many(g->label, label, n);
+    graph_append_zeros(g->edge_color, n);
+    return first;
+}
+
+// the handles taken from slot `id` are no longer valid
+internal void graph_bump_gen(uint32_t **gens, int id)
+{
+    if (da_size(*gens) <= (size_t)id) graph_append_zeros(*gens, id + 1 - da_size(*gens));
+    (*gens)[id]++;
+}
+
+// remove an edge, its slot is free for the next edge added
+void graph_remove_edge(Graph *g, int edge)
+{
+    assert(graph_edge_alive(g, edge));
+    g->from[edge] = -1;
+    g->to[edge]   = -1;
+    graph_bump_gen(&g->edge_gen, edge);
+    da_append(g->free_edges, edge);
+}
+
+// remove a node, its slot is free for the next node added.
+// NOTE: the edges of the node must have been removed before, the Graph doesn't
+// know them without a scan (see adjacency.c)
+void graph_remove_node(Graph *g, int node)
+{
+    assert(graph_node_alive(g, node));
+    size_t words = BITSET_WORDS(graph_num_nodes(g));
+    if (da_size(g->dead_nodes) < words)
+        graph_append_zeros(g->dead_nodes, words - da_size(g->dead_nodes));
+    bitset_set(g->dead_nodes, node);
+    graph_bump_gen(&g->node_gen, node);
+    da_append(g->free_nodes, node);
+}
+
+// remove the nodes and the edges whose bits are set in `nodes` and `edges`
+// (NULL for none), the edges of the nodes removed and the free slots, in one
+// pass. the ids left are compacted keeping their order. `node_map` and
+// `edge_map`, when not NULL, get the new id of every old one, -1 for the ones
+// removed
+void graph_remove_many(Graph *g, uint64_t *nodes, uint64_t *edges, int **node_map, int **edge_map)
+{
+    int *new_node = NULL;
+    int *new_edge = NULL;
+    if (node_map) new_node = *node_map;
+    if (edge_map) new_edge = *edge_map;
+    da_resize(new_node, graph_num_nodes(g));
+    da_resize(new_edge, graph_num_edges(g));
+
+    int kept = 0;
+    graph_foreach_node(g, i) {
+        if ((nodes && bitset_get(nodes, i)) || !graph_node_alive(g, i)) {
+            new_node[i] = -1;
+            continue;
+        }
+        new_node[i] = kept;
+        g->x[kept] = g->x[i];
+        g->y[kept] = g->y[i];
+        g->node_color[kept] = g->node_color[i];
+        kept++;
+    }
+    da_size(g->x) = kept;
+    da_size(g->y) = kept;
+    da_size(g->node_color) = kept;
+
+    kept = 0;
+    graph_foreach_edge(g, e) {
+        new_edge[e] = -1;
+        if (!graph_edge_alive(g, e) || (edges && bitset_get(edges, e))) continue;
+        int from = new_node[g->from[e]];
+        int to = new_node[g->to[e]];
+        if (from < 0 || to < 0) continue;
+        new_edge[e] = kept;
+        g->from[kept]    = from;
+        g->to[kept]      = to;
+        g->ctrl[0][kept] = g->ctrl[0][e];
+        g->ctrl[1][kept] = g->ctrl[1][e];
+        g->loffset[kept] = g->loffset[e];
+        g->label[kept]   = g->label[e];
+        g->edge_color[kept] = g->edge_color[e];
+        kept++;
+    }
+    da_size(g->from) = kept;
+    da_size(g->to) = kept;
+    da_size(g->ctrl[0]) = kept;
+    da_size(g->ctrl[1]) = kept;
+    da_size(g->loffset) = kept;
+    da_size(g->label) = kept;
+    da_size(g->edge_color) = kept;
+
+    da_size(g->free_nodes) = 0;
+    da_size(g->free_edges) = 0;
+    da_size(g->dead_nodes) = 0;
+    da_size(g->node_gen) = 0;
+    da_size(g->edge_gen) = 0;
+
+    // give back the memory of a graph that lost more than half of its items
+    graph_shrink_sparse(g->x);
+    graph_shrink_sparse(g->y);
+    graph_shrink_sparse(g->node_color);
+    graph_shrink_sparse(g->from);
+    graph_shrink_sparse(g->to);
+    graph_shrink_sparse(g->ctrl[0]);
+    graph_shrink_sparse(g->ctrl[1]);
+    graph_shrink_sparse(g->loffset);
+    graph_shrink_sparse(g->label);
+    graph_shrink_sparse(g->edge_color);
+
+    if (node_map) *node_map = new_node; else da_free(new_node);
+    if (edge_map) *edge_map = new_edge; else da_free(new_edge);
+}
+
+// drop the free slots, see graph_remove_many()
+void graph_compact(Graph *g, int **node_map, int **edge_map)
+{
+    graph_remove_many(g, NULL, NULL, node_map, edge_map);
+}
+
+void graph_free(Graph *g)
+{
+    da_free(g->x);
+    da_free(g->y);
+    da_free(g->from);
+    da_free(g->to);
+    da_free(g->ctrl[0]);
+    da_free(g->ctrl[1]);
+    da_free(g->loffset);
+    da_free(g->label);
+    da_free(g->node_color);
+    da_free(g->edge_color);
+    da_free(g->free_nodes);
+    da_free(g->free_edges);
+    da_free(g->dead_nodes);
+    da_free(g->node_gen);
+    da_free(g->edge_gen);
+    label_table_free(&g->labels);
+    graph_file_unmap(g->mapped, g->mapped_size);
+    *g = (Graph){0};
+}
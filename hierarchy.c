@@ -0,0 +1,495 @@
+// Layered layout
+//
+// the Sugiyama method, for the edges to flow downward:
+//  1. cycles are broken reversing the back edges of a depth first search
+//  2. each node goes to the layer of its longest path from a source, then the
+//     sources move down next to their closest successor
+//  3. the edges spanning several layers are split by a dummy node per layer
+//     crossed
+//  4. the order of the nodes of each layer is improved by barycenter sweeps,
+//     alternately down and up, keeping the order with the fewest crossings.
+//     the crossings between two layers are counted in O(E log V) with a Fenwick
+//     tree (Barth, Jünger and Mutzel)
+//  5. the nodes are pulled toward the mean x of their neighbours, keeping the
+//     order and the spacing of their layer
+// the control points of an edge point to the dummy nodes next to its ends, so
+// the curve follows the path found for it, or straight down between adjacent
+// layers. self loops are left as they are.
+
+#include <limits.h>
+
+#define HIER_LAYER_SPACING 200.0f
+#define HIER_NODE_SPACING 120.0f
+#define HIER_DUMMY_SPACING 30.0f
+#define HIER_SWEEPS 24              // at most
+#define HIER_PATIENCE 4             // sweeps without fewer crossings before giving up
+#define HIER_COORD_PASSES 8
+
+typedef struct HierKey {
+    float key;
+    int pos;            // before sorting, to break ties
+    int node;
+} HierKey;
+
+typedef struct Hierarchy {
+    int num_nodes;          // of the graph, the dummy nodes follow
+    int num_dummies;
+    int num_layers;
+    int *layer;             // per node
+    int *pos;               // in its layer
+    int *layer_start;       // layer l is layer_nodes[layer_start[l]] to layer_nodes[layer_start[l + 1] - 1]
+    int *layer_nodes;       // in order
+    int *up_start, *up;     // neighbours in the layer above, as compressed rows
+    int *down_start, *down; // in the layer below
+    int *first_dummy;       // per edge, the dummies of an edge follow from top to bottom, -1 for none
+    bool *reversed;         // per edge, to break a cycle
+    float *x;
+
+    // scratch
+    int *out_start, *out;
+    int *upper, *lower;     // layered edges
+    int *a, *b, *c;
+    int *best_pos;
+    HierKey *keys;
+    float *fa, *fb, *fc;
+
+    long initial_crossings; // before the sweeps
+    long crossings;         // of the final order
+    int sweeps;
+    double cycles_ms, layers_ms, order_ms, coords_ms;
+} Hierarchy;
+
+// rows of the `m` pairs (src[i], dst[i]) over `n` nodes, dst NULL for the pair
+// index
+internal void hier_csr(int n, int *src, int *dst, int m, int **start, int **adj)
+{
+    da_resize(*start, n + 1);
+    da_resize(*adj, m);
+    int *s = *start;
+    memset(s, 0, (n + 1)*sizeof(*s));
+    for (int i = 0; i < m; i++) s[src[i] + 1]++;
+    for (int i = 0; i < n; i++) s[i + 1] += s[i];
+    for (int i = 0; i < m; i++) (*adj)[s[src[i]]++] = (dst)? dst[i] : i;
+    for (int i = n; i > 0; i--) s[i] = s[i - 1];
+    s[0] = 0;
+}
+
+internal void hier_break_cycles(Hierarchy *h, Graph *g)
+{
+    int n = graph_num_nodes(g);
+    int m = graph_num_edges(g);
+    hier_csr(n, g->from, NULL, m, &h->out_start, &h->out);
+    da_resize(h->reversed, m);
+    memset(h->reversed, 0, m*sizeof(*h->reversed));
+
+    int *mark = h->a;       // 0 not seen, 1 on the stack, 2 done
+    int *cursor = h->b;
+    int *stack = h->c;
+    memset(mark, 0, n*sizeof(*mark));
+    memset(cursor, 0, n*sizeof(*cursor));      // in-degree first
+    for (int e = 0; e < m; e++) cursor[g->to[e]]++;
+
+    // from the sources first, their edges are kept
+    for (int pass = 0; pass < 2; pass++) {
+        for (int root = 0; root < n; root++) {
+            if (mark[root] || (pass == 0 && cursor[root] > 0)) continue;
+            int top = 0;
+            stack[top++] = root;
+            mark[root] = 1;
+            cursor[root] = h->out_start[root];
+            while (top > 0) {
+                int v = stack[top - 1];
+                if (cursor[v] == h->out_start[v + 1]) {
+                    mark[v] = 2;
+                    top--;
+                    continue;
+                }
+                int e = h->out[cursor[v]++];
+                int w = g->to[e];
+                if (w == v) continue;
+                if (mark[w] == 1) {
+                    h->reversed[e] = true;
+                } else if (mark[w] == 0) {
+                    mark[w] = 1;
+                    cursor[w] = h->out_start[w];
+                    stack[top++] = w;
+                }
+            }
+        }
+    }
+}
+
+// layers of the nodes, then the dummy nodes and the layered edges
+internal void hier_assign_layers(Hierarchy *h, Graph *g)
+{
+    int n = graph_num_nodes(g);
+    int m = graph_num_edges(g);
+
+    // the edges without loops, oriented downward
+    da_size(h->upper) = 0;
+    da_size(h->lower) = 0;
+    graph_foreach_edge(g, e) {
+        if (g->from[e] == g->to[e]) continue;
+        da_append(h->upper, h->reversed[e]? g->to[e] : g->from[e]);
+        da_append(h->lower, h->reversed[e]? g->from[e] : g->to[e]);
+    }
+    int num_oriented = da_size(h->upper);
+    hier_csr(n, h->upper, h->lower, num_oriented, &h->out_start, &h->out);
+
+    // longest paths, in topological order
+    int *indegree = h->a;
+    int *queue = h->b;
+    memset(indegree, 0, n*sizeof(*indegree));
+    for (int i = 0; i < num_oriented; i++) indegree[h->lower[i]]++;
+    da_resize(h->layer, n);
+    int head = 0, tail = 0;
+    for (int v = 0; v < n; v++) {
+        h->layer[v] = 0;
+        if (indegree[v] == 0) queue[tail++] = v;
+    }
+    while (head < tail) {
+        int v = queue[head++];
+        for (int i = h->out_start[v]; i < h->out_start[v + 1]; i++) {
+            int w = h->out[i];
+            if (h->layer[w] < h->layer[v] + 1) h->layer[w] = h->layer[v] + 1;
+            if (--indegree[w] == 0) queue[tail++] = w;
+        }
+    }
+    assert(tail == n);
+
+    // the successors of a source are not sources, their layers are final
+    for (int i = 0; i < num_oriented; i++) indegree[h->lower[i]]++;
+    h->num_layers = 0;
+    for (int v = 0; v < n; v++) {
+        if (indegree[v] == 0 && h->out_start[v] < h->out_start[v + 1]) {
+            int closest = INT_MAX;
+            for (int i = h->out_start[v]; i < h->out_start[v + 1]; i++)
+                if (h->layer[h->out[i]] < closest) closest = h->layer[h->out[i]];
+            h->layer[v] = closest - 1;
+        }
+        if (h->layer[v] + 1 > h->num_layers) h->num_layers = h->layer[v] + 1;
+    }
+
+    // split the long edges
+    da_resize(h->first_dummy, m);
+    da_size(h->upper) = 0;
+    da_size(h->lower) = 0;
+    int total = n;
+    graph_foreach_edge(g, e) {
+        h->first_dummy[e] = -1;
+        if (g->from[e] == g->to[e]) continue;
+        int u = h->reversed[e]? g->to[e] : g->from[e];
+        int v = h->reversed[e]? g->from[e] : g->to[e];
+        int prev = u;
+        if (h->layer[v] - h->layer[u] > 1) {
+            h->first_dummy[e] = total;
+            for (int l = h->layer[u] + 1; l < h->layer[v]; l++) {
+                da_append(h->layer, l);
+                da_append(h->upper, prev);
+                da_append(h->lower, total);
+                prev = total++;
+            }
+        }
+        da_append(h->upper, prev);
+        da_append(h->lower, v);
+    }
+    h->num_nodes = n;
+    h->num_dummies = total - n;
+
+    int num_layered = da_size(h->upper);
+    hier_csr(total, h->lower, h->upper, num_layered, &h->up_start, &h->up);
+    hier_csr(total, h->upper, h->lower, num_layered, &h->down_start, &h->down);
+
+    // the layers, by id to begin with
+    da_resize(h->layer_start, h->num_layers + 1);
+    memset(h->layer_start, 0, (h->num_layers + 1)*sizeof(*h->layer_start));
+    for (int v = 0; v < total; v++) h->layer_start[h->layer[v] + 1]++;
+    for (int l = 0; l < h->num_layers; l++) h->layer_start[l + 1] += h->layer_start[l];
+    da_resize(h->layer_nodes, total);
+    da_resize(h->pos, total);
+    for (int v = 0; v < total; v++) {
+        int l = h->layer[v];
+        int i = h->layer_start[l]++;
+        h->layer_nodes[i] = v;
+    }
+    for (int l = h->num_layers; l > 0; l--) h->layer_start[l] = h->layer_start[l - 1];
+    h->layer_start[0] = 0;
+    for (int l = 0; l < h->num_layers; l++)
+        for (int i = h->layer_start[l]; i < h->layer_start[l + 1]; i++)
+            h->pos[h->layer_nodes[i]] = i - h->layer_start[l];
+}
+
+internal int hier_key_cmp(const void *a, const void *b)
+{
+    const HierKey *ka = a;
+    const HierKey *kb = b;
+    if (ka->key != kb->key) return (ka->key < kb->key)? -1 : 1;
+    return ka->pos - kb->pos;
+}
+
+// order layer `l` by the mean position of the neighbours given by `start` and
+// `adj`, the nodes without any stay where they are
+internal void hier_sort_layer(Hierarchy *h, int l, int *start, int *adj)
+{
+    int begin = h->layer_start[l];
+    int size = h->layer_start[l + 1] - begin;
+    HierKey *keys = h->keys;
+    for (int i = 0; i < size; i++) {
+        int v = h->layer_nodes[begin + i];
+        float key = i;
+        if (start[v] < start[v + 1]) {
+            int sum = 0;
+            for (int k = start[v]; k < start[v + 1]; k++) sum += h->pos[adj[k]];
+            key = (float)sum/(start[v + 1] - start[v]);
+        }
+        keys[i] = (HierKey){key, i, v};
+    }
+    qsort(keys, size, sizeof(*keys), hier_key_cmp);
+    for (int i = 0; i < size; i++) {
+        h->layer_nodes[begin + i] = keys[i].node;
+        h->pos[keys[i].node] = i;
+    }
+}
+
+// crossings between layers `l` and `l + 1`: the layered edges taken by their
+// upper end, left to right, cross all the edges taken before whose lower end is
+// further right
+internal long hier_layer_crossings(Hierarchy *h, int l)
+{
+    int size = h->layer_start[l + 2] - h->layer_start[l + 1];
+    int *tree = h->a;       // Fenwick tree of the lower ends seen, from 1
+    int *ends = h->b;
+    memset(tree, 0, (size + 1)*sizeof(*tree));
+    long crossings = 0;
+    int seen = 0;
+    for (int i = h->layer_start[l]; i < h->layer_start[l + 1]; i++) {
+        int v = h->layer_nodes[i];
+        int n = 0;
+        for (int k = h->down_start[v]; k < h->down_start[v + 1]; k++) {
+            // insertion sort, the edges of a node don't cross each other
+            int p = h->pos[h->down[k]];
+            int j = n++;
+            for (; j > 0 && ends[j - 1] > p; j--) ends[j] = ends[j - 1];
+            ends[j] = p;
+        }
+        for (int k = 0; k < n; k++) {
+            int not_after = 0;
+            for (int j = ends[k] + 1; j > 0; j -= j & -j) not_after += tree[j];
+            crossings += seen - not_after;
+            for (int j = ends[k] + 1; j <= size; j += j & -j) tree[j]++;
+            seen++;
+        }
+    }
+    return crossings;
+}
+
+internal long hier_crossings(Hierarchy *h)
+{
+    long crossings = 0;
+    for (int l = 0; l + 1 < h->num_layers; l++) crossings += hier_layer_crossings(h, l);
+    return crossings;
+}
+
+internal void hier_order(Hierarchy *h)
+{
+    int total = h->num_nodes + h->num_dummies;
+    int max_size = 0;
+    for (int l = 0; l < h->num_layers; l++) {
+        int size = h->layer_start[l + 1] - h->layer_start[l];
+        if (size > max_size) max_size = size;
+    }
+    da_resize(h->keys, max_size);
+    da_resize(h->best_pos, total);
+    // the ends of the edges of one node, for the crossings
+    int max_degree = 0;
+    for (int v = 0; v < total; v++) {
+        int degree = h->down_start[v + 1] - h->down_start[v];
+        if (degree > max_degree) max_degree = degree;
+    }
+    da_resize(h->b, (max_degree > max_size)? max_degree : max_size);
+
+    long best = hier_crossings(h);
+    h->initial_crossings = best;
+    memcpy(h->best_pos, h->pos, total*sizeof(*h->pos));
+    int stall = 0;
+    h->sweeps = 0;
+    for (int sweep = 0; sweep < HIER_SWEEPS && best > 0 && stall < HIER_PATIENCE; sweep++) {
+        if (sweep % 2 == 0) {
+            for (int l = 1; l < h->num_layers; l++) hier_sort_layer(h, l, h->up_start, h->up);
+        } else {
+            for (int l = h->num_layers - 2; l >= 0; l--)
+                hier_sort_layer(h, l, h->down_start, h->down);
+        }
+        h->sweeps++;
+        long crossings = hier_crossings(h);
+        if (crossings < best) {
+            best = crossings;
+            memcpy(h->best_pos, h->pos, total*sizeof(*h->pos));
+            stall = 0;
+        } else {
+            stall++;
+        }
+    }
+
+    memcpy(h->pos, h->best_pos, total*sizeof(*h->pos));
+    for (int v = 0; v < total; v++)
+        h->layer_nodes[h->layer_start[h->layer[v]] + h->pos[v]] = v;
+    h->crossings = best;
+}
+
+inline internal float hier_width(Hierarchy *h, int v)
+{
+    return (v < h->num_nodes)? HIER_NODE_SPACING : HIER_DUMMY_SPACING;
+}
+
+// move the nodes of layer `l` toward the mean x of their neighbours given by
+// `start` and `adj`, as close as the spacing allows: the mean of the leftmost
+// and of the rightmost placement that keep the order
+internal void hier_place_layer(Hierarchy *h, int l, int *start, int *adj)
+{
+    int begin = h->layer_start[l];
+    int size = h->layer_start[l + 1] - begin;
+    if (size == 0) return;
+    int *nodes = h->layer_nodes + begin;
+    float *want = h->fa;
+    float *left = h->fb;
+    float *right = h->fc;
+    for (int i = 0; i < size; i++) {
+        int v = nodes[i];
+        want[i] = h->x[v];
+        if (start[v] < start[v + 1]) {
+            float sum = 0;
+            for (int k = start[v]; k < start[v + 1]; k++) sum += h->x[adj[k]];
+            want[i] = sum/(start[v + 1] - start[v]);
+        }
+    }
+    left[0] = want[0];
+    for (int i = 1; i < size; i++) {
+        float min = left[i - 1] + (hier_width(h, nodes[i - 1]) + hier_width(h, nodes[i]))/2;
+        left[i] = fmaxf(want[i], min);
+    }
+    right[size - 1] = want[size - 1];
+    for (int i = size - 2; i >= 0; i--) {
+        float max = right[i + 1] - (hier_width(h, nodes[i + 1]) + hier_width(h, nodes[i]))/2;
+        right[i] = fminf(want[i], max);
+    }
+    for (int i = 0; i < size; i++) h->x[nodes[i]] = (left[i] + right[i])/2;
+}
+
+internal void hier_place(Hierarchy *h)
+{
+    int total = h->num_nodes + h->num_dummies;
+    int max_size = da_size(h->keys);
+    da_resize(h->fa, max_size);
+    da_resize(h->fb, max_size);
+    da_resize(h->fc, max_size);
+    da_resize(h->x, total);
+
+    // packed, centered on x = 0
+    for (int l = 0; l < h->num_layers; l++) {
+        float x = 0;
+        int prev = -1;
+        for (int i = h->layer_start[l]; i < h->layer_start[l + 1]; i++) {
+            int v = h->layer_nodes[i];
+            if (prev >= 0) x += (hier_width(h, prev) + hier_width(h, v))/2;
+            h->x[v] = x;
+            prev = v;
+        }
+        for (int i = h->layer_start[l]; i < h->layer_start[l + 1]; i++)
+            h->x[h->layer_nodes[i]] -= x/2;
+    }
+
+    for (int pass = 0; pass < HIER_COORD_PASSES; pass++) {
+        if (pass % 2 == 0) {
+            for (int l = 1; l < h->num_layers; l++) hier_place_layer(h, l, h->up_start, h->up);
+        } else {
+            for (int l = h->num_layers - 2; l >= 0; l--)
+                hier_place_layer(h, l, h->down_start, h->down);
+        }
+    }
+}
+
+inline internal Vector2 hier_node_pos(Hierarchy *h, int v)
+{
+    return (Vector2){h->x[v], h->layer[v]*HIER_LAYER_SPACING};
+}
+
+// lay `g` out in layers, overwriting the positions of the nodes and the control
+// points of the edges
+void hierarchy_layout(Hierarchy *h, Graph *g)
+{
+    assert(!graph_has_free_slots(g) && "compact the graph first");
+    int n = graph_num_nodes(g);
+    if (n == 0) return;
+    da_resize(h->a, n);
+    da_resize(h->b, n);
+    da_resize(h->c, n);
+
+    double start = now_ms();
+    hier_break_cycles(h, g);
+    h->cycles_ms = now_ms() - start;
+
+    start = now_ms();
+    hier_assign_layers(h, g);
+    h->layers_ms = now_ms() - start;
+
+    start = now_ms();
+    int max_size = 0;
+    for (int l = 0; l < h->num_layers; l++) {
+        int size = h->layer_start[l + 1] - h->layer_start[l];
+        if (size > max_size) max_size = size;
+    }
+    da_resize(h->a, max_size + 1);
+    hier_order(h);
+    h->order_ms = now_ms() - start;
+
+    start = now_ms();
+    hier_place(h);
+    h->coords_ms = now_ms() - start;
+
+    graph_foreach_node(g, v) graph_set_node_pos(g, v, hier_node_pos(h, v));
+    graph_foreach_edge(g, e) {
+        int from = g->from[e];
+        int to = g->to[e];
+        if (from == to) continue;
+        Vector2 p1 = graph_node_pos(g, from);
+        Vector2 p2 = graph_node_pos(g, to);
+        int d = h->first_dummy[e];
+        if (d < 0) {
+            g->ctrl[0][e] = (Vector2){0, (p2.y - p1.y)/2};
+            g->ctrl[1][e] = (Vector2){0, (p1.y - p2.y)/2};
+            continue;
+        }
+        int last = d + abs(h->layer[to] - h->layer[from]) - 2;
+        g->ctrl[0][e] = Vector2Subtract(hier_node_pos(h, h->reversed[e]? last : d), p1);
+        g->ctrl[1][e] = Vector2Subtract(hier_node_pos(h, h->reversed[e]? d : last), p2);
+    }
+}
+
+void hierarchy_free(Hierarchy *h)
+{
+    da_free(h->layer);
+    da_free(h->pos);
+    da_free(h->layer_start);
+    da_free(h->layer_nodes);
+    da_free(h->up_start);
+    da_free(h->up);
+    da_free(h->down_start);
+    da_free(h->down);
+    da_free(h->first_dummy);
+    da_free(h->reversed);
+    da_free(h->x);
+    da_free(h->out_start);
+    da_free(h->out);
+    da_free(h->upper);
+    da_free(h->lower);
+    da_free(h->a);
+    da_free(h->b);
+    da_free(h->c);
+    da_free(h->best_pos);
+    da_free(h->keys);
+    da_free(h->fa);
+    da_free(h->fb);
+    da_free(h->fc);
+    *h = (Hierarchy){0};
+}
@@ -0,0 +1,1123 @@
+// Text importers
+//
+// edge lists, Graphviz DOT and GraphML files are read in chunks of
+// IMPORT_CHUNK_SIZE bytes into a fixed buffer. the parsers consume only complete
+// lines, tokens or tags and what is left at the end of a chunk is moved to the
+// front of the buffer for the next one, so the memory used doesn't depend on the
+// size of the file. temporary strings (unescaped quoted strings, decoded XML) go
+// to an arena reset every chunk.
+//
+// import_chunk() parses one chunk into an ImportBatch that owns everything it
+// refers to, so it can be made on a worker thread and appended to a graph on
+// another one with import_batch_apply() (see loader.c). import_step() does both
+// on the calling thread for a given time budget.
+//
+// supported input:
+//  - edge list: one `from to [label]` per line, separated by spaces, tabs or
+//    commas. a single name adds an isolated node, lines starting with # or %
+//    are comments
+//  - DOT: node, edge and attribute statements, edge chains, subgraphs (just as
+//    scopes, not as edge endpoints), ports are skipped. edge `label` and node
+//    `pos` are read, the other attributes are ignored
+//  - GraphML: <node id>, <edge source target> and the <data> of the keys whose
+//    attr.name is "label" for edges and "x", "y" for nodes
+//
+// nodes are placed on a sunflower spiral when they are created, until the file
+// gives them a position, and edges get control points for a gentle curve
+// between the positions their nodes have at that point, so a partially
+// imported graph already looks like the complete one.
+
+#include <strings.h>
+
+#define IMPORT_CHUNK_SIZE (1 << 20)
+#define IMPORT_NODE_SPACING 200.0f
+#define IMPORT_GOLDEN_ANGLE 2.39996323f
+#define IMPORT_MAX_ATTRS 16
+#define IMPORT_LINE_BATCH 32
+#define IMPORT_MAX_NUMBER_NAME (1 << 24)
+#define IMPORT_NUMBER_SLACK 4           // numbers mapped densely per node created
+#define IMPORT_NUMBER_MIN_DENSE 4096
+
+enum ImportFormat {
+    IF_EDGE_LIST,
+    IF_DOT,
+    IF_GRAPHML,
+};
+
+enum ImportStatus {
+    IS_RUNNING,
+    IS_DONE,
+    IS_ERROR,
+};
+
+enum DotState {
+    DS_STMT,            // start of a statement
+    DS_NODE,            // after a node id
+    DS_EDGE_TARGET,     // after an edge operator
+    DS_PORT,            // after `:`, the port id is skipped
+    DS_ATTR_KEY,        // inside [ ]
+    DS_ATTR_EQ,
+    DS_ATTR_VALUE,
+    DS_GRAPH_ATTR,      // after `id =` at statement level, the value is skipped
+    DS_SUBGRAPH,        // after `subgraph`, an optional id
+};
+
+enum AttrKey {
+    AK_OTHER,
+    AK_LABEL,
+    AK_POS,
+};
+
+enum ImportData {
+    ID_NONE,
+    ID_LABEL,
+    ID_X,
+    ID_Y,
+};
+
+typedef struct DotParser {
+    enum DotState state;
+    enum DotState after_port;
+    enum AttrKey key;
+    int depth;          // of { }
+    int node;           // last node of the statement, -1 for attribute statements
+    int first_edge;     // first edge of the statement
+    bool in_edges;      // the statement is an edge chain
+} DotParser;
+
+typedef struct GraphmlParser {
+    char label_key[64];
+    char x_key[64];
+    char y_key[64];
+    int node;           // inside <node>, or -1
+    int edge;           // inside <edge>, or -1
+    enum ImportData data;
+    char *text;         // content of the current <data>
+} GraphmlParser;
+
+// the nodes, edges and labels created while parsing one chunk, in the order they
+// were created, and the changes to those of the previous chunks. labels are
+// referred to by their id in the importer's table, import_batch_apply() maps
+// them to the labels of the target graph
+typedef struct ImportBatch {
+    float *node_x;
+    float *node_y;
+    int *edge_from;
+    int *edge_to;
+    Vector2 *edge_c1;
+    Vector2 *edge_c2;
+    Vector2 *edge_loffset;
+    int *edge_label;
+
+    char *label_chars;      // the new labels, one after the other
+    uint32_t *label_len;
+
+    int *moved_node;        // nodes of previous batches given a position
+    Vector2 *moved_pos;
+    int *relabeled_edge;    // edges of previous batches given a label
+    int *relabeled_label;
+
+    size_t bytes_done;      // of the file, once the chunk is parsed
+} ImportBatch;
+
+typedef struct Importer {
+    enum ImportFormat format;
+    enum ImportStatus status;
+    const char *error;
+    FILE *file;
+    size_t file_size;
+    size_t bytes_done;  // consumed by the parser
+
+    char *buf;          // IMPORT_CHUNK_SIZE bytes
+    size_t buf_len;
+    bool eof;
+    Arena scratch;      // temporary strings of the current chunk
+
+    LabelTable names;   // node names
+    int *name_node;     // node of each name in `names`
+    int *number_node;   // node of the names that are small numbers, or -1
+    int *sparse_number; // numbers past number_node when first seen, in `names`
+    int *sparse_node;
+    Vector2 *node_pos;  // of every node created so far
+    LabelTable labels;  // edge labels
+    int empty_label;
+    int num_edges;      // created so far
+
+    // the batch of the current chunk, it holds the nodes and edges from
+    // first_node and first_edge on, and the labels from first_label on
+    ImportBatch batch;
+    int first_node;
+    int first_edge;
+    int first_label;
+
+    // used by import_step() only
+    Graph g;
+    int *label_map;
+
+    DotParser dot;
+    GraphmlParser gml;
+} Importer;
+
+internal bool str_eq(const char *s, size_t len, const char *lit)
+{
+    return strlen(lit) == len && memcmp(s, lit, len) == 0;
+}
+
+internal bool str_eq_nocase(const char *s, size_t len, const char *lit)
+{
+    return strlen(lit) == len && strncasecmp(s, lit, len) == 0;
+}
+
+// guess the format from the extension of `path`
+enum ImportFormat import_format_from_path(const char *path)
+{
+    if (IsFileExtension(path, ".dot;.gv")) return IF_DOT;
+    if (IsFileExtension(path, ".graphml;.xml")) return IF_GRAPHML;
+    return IF_EDGE_LIST;
+}
+
+//
+// building the graph
+//
+
+internal int import_new_node(Importer *imp)
+{
+    int id = da_size(imp->node_pos);
+    float r = IMPORT_NODE_SPACING*sqrtf(id/PI);
+    float a = id*IMPORT_GOLDEN_ANGLE;
+    Vector2 pos = {r*cosf(a), r*sinf(a)};
+    da_append(imp->node_pos, pos);
+    da_append(imp->batch.node_x, pos.x);
+    da_append(imp->batch.node_y, pos.y);
+    return id;
+}
+
+// node of the name with id `id` in imp->names, added the first time it is seen
+internal int import_name_node(Importer *imp, int id)
+{
+    if (id == (int)da_size(imp->name_node)) da_append(imp->name_node, import_new_node(imp));
+    return imp->name_node[id];
+}
+
+// names like "0" or "1234" (not "01") up to IMPORT_MAX_NUMBER_NAME are mapped to
+// nodes with an array instead of the hash table. returns -1 for other names
+internal int import_name_number(const char *name, size_t len)
+{
+    if (len == 0 || len > 8 || (name[0] == '0' && len > 1)) return -1;
+    int n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (name[i] < '0' || name[i] > '9') return -1;
+        n = 10*n + (name[i] - '0');
+    }
+    return (n < IMPORT_MAX_NUMBER_NAME)? n : -1;
+}
+
+// the array only covers numbers up to IMPORT_NUMBER_SLACK times the nodes created
+// so far, so a file with a few large numbers doesn't allocate an entry for every
+// number below them. the numbers past it go to the hash table like other names,
+// and are copied to the array when it grows over them
+internal int import_number_node(Importer *imp, int number)
+{
+    int size = da_size(imp->number_node);
+    if (number >= size) {
+        int limit = IMPORT_NUMBER_SLACK*(int)da_size(imp->node_pos) + IMPORT_NUMBER_MIN_DENSE;
+        if (number >= limit) {
+            char str[16];
+            int len = snprintf(str, sizeof(str), "%d", number);
+            int id = label_intern_len(&imp->names, str, len);
+            if (id < (int)da_size(imp->name_node)) return imp->name_node[id];
+            da_append(imp->sparse_number, number);
+            da_append(imp->sparse_node, import_name_node(imp, id));
+            return imp->name_node[id];
+        }
+
+        int new_size = (2*size < limit)? 2*size : limit;
+        if (new_size <= number) new_size = number + 1;
+        da_resize(imp->number_node, new_size);
+        memset(imp->number_node + size, -1, (new_size - size)*sizeof(int));
+        for (size_t i = 0; i < da_size(imp->sparse_number); i++) {
+            int n = imp->sparse_number[i];
+            if (n >= size && n < new_size) imp->number_node[n] = imp->sparse_node[i];
+        }
+    }
+    if (imp->number_node[number] < 0) imp->number_node[number] = import_new_node(imp);
+    return imp->number_node[number];
+}
+
+internal int import_node(Importer *imp, const char *name, size_t len)
+{
+    int number = import_name_number(name, len);
+    if (number >= 0) return import_number_node(imp, number);
+    return import_name_node(imp, label_intern_len(&imp->names, name, len));
+}
+
+internal void import_node_pos(Importer *imp, int node, float x, float y)
+{
+    ImportBatch *b = &imp->batch;
+    imp->node_pos[node] = (Vector2){x, y};
+    if (node < imp->first_node) {
+        da_append(b->moved_node, node);
+        da_append(b->moved_pos, imp->node_pos[node]);
+    } else {
+        b->node_x[node - imp->first_node] = x;
+        b->node_y[node - imp->first_node] = y;
+    }
+}
+
+// returns the id the edge will have in the graph. the control points follow the
+// current position of the nodes: an edge created before the file positions
+// its nodes keeps the curve it got from their placeholder positions
+internal int import_edge(Importer *imp, int from, int to, int label)
+{
+    Vector2 c1, c2;
+    edge_default_ctrl(imp->node_pos[from], imp->node_pos[to], from == to, &c1, &c2);
+
+    ImportBatch *b = &imp->batch;
+    da_append(b->edge_from, from);
+    da_append(b->edge_to, to);
+    da_append(b->edge_c1, c1);
+    da_append(b->edge_c2, c2);
+    da_append(b->edge_loffset, (Vector2){0});
+    da_append(b->edge_label, label);
+    return imp->num_edges++;
+}
+
+internal void import_edge_label(Importer *imp, int edge, const char *str, size_t len)
+{
+    ImportBatch *b = &imp->batch;
+    int label = label_intern_len(&imp->labels, str, len);
+    if (edge < imp->first_edge) {
+        da_append(b->relabeled_edge, edge);
+        da_append(b->relabeled_label, label);
+    } else {
+        b->edge_label[edge - imp->first_edge] = label;
+    }
+}
+
+// hand the batch of the chunk over to `out` and start the next one
+internal void import_flush(Importer *imp, ImportBatch *out)
+{
+    ImportBatch *b = &imp->batch;
+    int num_labels = da_size(imp->labels.entries);
+    for (int i = imp->first_label; i < num_labels; i++) {
+        LabelEntry *e = imp->labels.entries + i;
+        da_append_many(b->label_chars, e->str, e->len);
+        da_append(b->label_len, e->len);
+    }
+    b->bytes_done = imp->bytes_done;
+
+    *out = *b;
+    *b = (ImportBatch){0};
+    imp->first_node = da_size(imp->node_pos);
+    imp->first_edge = imp->num_edges;
+    imp->first_label = num_labels;
+}
+
+//
+// edge list
+//
+
+internal bool edge_list_sep(char c)
+{
+    return c == ' ' || c == '\t' || c == ',';
+}
+
+typedef struct EdgeListBatch {
+    const char *names[2*IMPORT_LINE_BATCH];     // the names that are not numbers
+    size_t lens[2*IMPORT_LINE_BATCH];
+    int num_names;
+    int number[2*IMPORT_LINE_BATCH];            // per endpoint, -1 for the next name
+    int num_ends;
+    bool has_to[IMPORT_LINE_BATCH];
+    int label[IMPORT_LINE_BATCH];
+    int num_lines;
+} EdgeListBatch;
+
+internal void import_edge_list_batch(Importer *imp, EdgeListBatch *b)
+{
+    int ids[2*IMPORT_LINE_BATCH];
+    label_intern_many(&imp->names, b->names, b->lens, ids, b->num_names);
+    int k = 0;
+    int end = 0;
+    for (int i = 0; i < b->num_lines; i++) {
+        int ends[2];
+        int num_ends = (b->has_to[i])? 2 : 1;
+        for (int j = 0; j < num_ends; j++, end++) {
+            ends[j] = (b->number[end] >= 0)? import_number_node(imp, b->number[end])
+                : import_name_node(imp, ids[k++]);
+        }
+        if (num_ends == 2) import_edge(imp, ends[0], ends[1], b->label[i]);
+    }
+    b->num_names = 0;
+    b->num_ends = 0;
+    b->num_lines = 0;
+}
+
+internal void edge_list_batch_name(EdgeListBatch *b, const char *name, size_t len)
+{
+    int number = import_name_number(name, len);
+    b->number[b->num_ends++] = number;
+    if (number < 0) {
+        b->names[b->num_names] = name;
+        b->lens[b->num_names++] = len;
+    }
+}
+
+internal void import_edge_list_line(Importer *imp, EdgeListBatch *batch, char *s, char *end)
+{
+    while (end > s && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) end--;
+    while (s < end && edge_list_sep(*s)) s++;
+    if (s == end || *s == '#' || *s == '%') return;
+
+    char *a = s;
+    while (s < end && !edge_list_sep(*s)) s++;
+    size_t a_len = s - a;
+    while (s < end && edge_list_sep(*s)) s++;
+    char *b = s;
+    while (s < end && !edge_list_sep(*s)) s++;
+    size_t b_len = s - b;
+    while (s < end && edge_list_sep(*s)) s++;
+
+    int line = batch->num_lines++;
+    edge_list_batch_name(batch, a, a_len);
+    batch->has_to[line] = b_len > 0;
+    if (b_len > 0) edge_list_batch_name(batch, b, b_len);
+    batch->label[line] = (s < end)? label_intern_len(&imp->labels, s, end - s)
+        : imp->empty_label;
+    if (batch->num_lines == IMPORT_LINE_BATCH) import_edge_list_batch(imp, batch);
+}
+
+// returns the number of bytes consumed, complete lines only unless at `eof`.
+// the node names of IMPORT_LINE_BATCH lines are looked up together
+internal size_t import_edge_list(Importer *imp, char *buf, size_t len, bool eof)
+{
+    EdgeListBatch batch;
+    batch.num_names = 0;
+    batch.num_ends = 0;
+    batch.num_lines = 0;
+    size_t pos = 0;
+    while (pos < len) {
+        char *line = buf + pos;
+        char *nl = memchr(line, '\n', len - pos);
+        if (!nl && !eof) break;
+        char *end = (nl)? nl : buf + len;
+        import_edge_list_line(imp, &batch, line, end);
+        pos = end - buf + (nl != NULL);
+    }
+    import_edge_list_batch(imp, &batch);
+    return pos;
+}
+
+//
+// DOT
+//
+
+enum DotTokenType {
+    DT_MORE,            // incomplete, needs the next chunk
+    DT_END,
+    DT_ID,
+    DT_EDGE_OP,
+    DT_PUNCT,
+};
+
+typedef struct DotToken {
+    enum DotTokenType type;
+    char c;             // DT_PUNCT
+    const char *str;    // DT_ID
+    size_t len;
+} DotToken;
+
+internal bool dot_id_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+        || c == '_' || c == '.' || (unsigned char)c >= 0x80;
+}
+
+// unescape a quoted string into the scratch arena. \" and line continuations
+// are removed, \n \l \r become new lines
+internal char *dot_unquote(Importer *imp, const char *s, size_t len, size_t *out_len)
+{
+    arena_set_allign(&imp->scratch, 1);
+    char *result = arena_push_size(&imp->scratch, len + 1);
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] == '\\' && i + 1 < len) {
+            char e = s[++i];
+            if (e == '\n') continue;
+            if (e == '\r' && i + 1 < len && s[i + 1] == '\n') {
+                i++;
+                continue;
+            }
+            if (e == 'n' || e == 'l' || e == 'r') {
+                result[n++] = '\n';
+            } else if (e == '"' || e == '\\') {
+                result[n++] = e;
+            } else {
+                result[n++] = '\\';
+                result[n++] = e;
+            }
+        } else {
+            result[n++] = s[i];
+        }
+    }
+    result[n] = '\0';
+    *out_len = n;
+    return result;
+}
+
+// next token starting at *pos. *pos is left on the start of an incomplete token
+internal DotToken dot_next_token(Importer *imp, char *buf, size_t len, size_t *pos, bool eof)
+{
+    DotToken tok = {DT_MORE};
+    size_t i = *pos;
+
+    // whitespace and comments
+    for (;;) {
+        while (i < len && (buf[i] == ' ' || buf[i] == '\t' || buf[i] == '\n' || buf[i] == '\r'))
+            i++;
+        *pos = i;
+        if (i == len) {
+            if (eof) tok.type = DT_END;
+            return tok;
+        }
+        if (buf[i] == '/' && i + 1 == len && !eof) return tok;
+        char next = (i + 1 < len)? buf[i + 1] : '\0';
+        bool line_comment = buf[i] == '#' || (buf[i] == '/' && next == '/');
+        bool block_comment = buf[i] == '/' && next == '*';
+        if (line_comment) {
+            char *nl = memchr(buf + i, '\n', len - i);
+            if (!nl && !eof) return tok;
+            i = (nl)? (size_t)(nl - buf) + 1 : len;
+        } else if (block_comment) {
+            size_t j = i + 2;
+            while (j + 1 < len && !(buf[j] == '*' && buf[j + 1] == '/')) j++;
+            if (j + 1 >= len) {
+                if (!eof) return tok;
+                j = len;
+            }
+            i = (j + 2 < len)? j + 2 : len;
+        } else if (!strchr("[]{};,=:-\"<", buf[i]) && !dot_id_char(buf[i])) {
+            // not valid DOT, skip the character
+            i++;
+        } else {
+            break;
+        }
+    }
+
+    char c = buf[i];
+    if (strchr("[]{};,=:", c)) {
+        tok.type = DT_PUNCT;
+        tok.c = c;
+        *pos = i + 1;
+        return tok;
+    }
+
+    if (c == '-' && i + 1 == len && !eof) return tok;
+    if (c == '-' && i + 1 < len && (buf[i + 1] == '>' || buf[i + 1] == '-')) {
+        tok.type = DT_EDGE_OP;
+        *pos = i + 2;
+        return tok;
+    }
+
+    if (c == '"') {
+        size_t j = i + 1;
+        while (j < len && buf[j] != '"') j += (buf[j] == '\\')? 2 : 1;
+        if (j >= len) {
+            if (!eof) return tok;
+            imp->error = "unterminated string";
+            tok.type = DT_END;
+            return tok;
+        }
+        tok.type = DT_ID;
+        tok.str = dot_unquote(imp, buf + i + 1, j - i - 1, &tok.len);
+        *pos = j + 1;
+        return tok;
+    }
+
+    if (c == '<') {
+        // HTML string, nested < >
+        size_t j = i + 1;
+        int depth = 1;
+        for (; j < len && depth > 0; j++) {
+            if (buf[j] == '<') depth++;
+            if (buf[j] == '>') depth--;
+        }
+        if (depth > 0) {
+            if (!eof) return tok;
+            imp->error = "unterminated HTML string";
+            tok.type = DT_END;
+            return tok;
+        }
+        tok.type = DT_ID;
+        tok.str = buf + i + 1;
+        tok.len = j - i - 2;
+        *pos = j;
+        return tok;
+    }
+
+    // identifiers and numerals, with an optional minus sign
+    size_t j = (c == '-')? i + 1 : i;
+    while (j < len && dot_id_char(buf[j])) j++;
+    if (j == len && !eof) return tok;
+    if (j == i + 1 && c == '-') {
+        // a lone minus, not valid DOT
+        tok.type = DT_PUNCT;
+        tok.c = c;
+        *pos = j;
+        return tok;
+    }
+    tok.type = DT_ID;
+    tok.str = buf + i;
+    tok.len = j - i;
+    *pos = j;
+    return tok;
+}
+
+internal void dot_attr(Importer *imp, enum AttrKey key, const char *value, size_t len)
+{
+    DotParser *p = &imp->dot;
+    if (key == AK_LABEL && p->in_edges) {
+        for (int e = p->first_edge; e < imp->num_edges; e++)
+            import_edge_label(imp, e, value, len);
+    } else if (key == AK_POS && !p->in_edges && p->node >= 0) {
+        // points, with y up
+        char tmp[64];
+        if (len >= sizeof(tmp)) return;
+        memcpy(tmp, value, len);
+        tmp[len] = '\0';
+        float x, y;
+        if (sscanf(tmp, "%f,%f", &x, &y) == 2)
+            import_node_pos(imp, p->node, x, -y);
+    }
+}
+
+internal void dot_token(Importer *imp, DotToken tok)
+{
+    DotParser *p = &imp->dot;
+    bool punct = tok.type == DT_PUNCT;
+    bool id = tok.type == DT_ID;
+
+    switch (p->state) {
+    case DS_NODE:
+        if (tok.type == DT_EDGE_OP && p->node >= 0) {
+            if (!p->in_edges) p->first_edge = imp->num_edges;
+            p->in_edges = true;
+            p->state = DS_EDGE_TARGET;
+            return;
+        }
+        if (punct && tok.c == ':') {
+            p->after_port = DS_NODE;
+            p->state = DS_PORT;
+            return;
+        }
+        if (punct && tok.c == '[') {
+            p->state = DS_ATTR_KEY;
+            return;
+        }
+        if (punct && tok.c == '=') {
+            p->state = DS_GRAPH_ATTR;
+            return;
+        }
+        // anything else starts a new statement
+        p->state = DS_STMT;
+        break;
+
+    case DS_EDGE_TARGET:
+        if (id) {
+            int to = import_node(imp, tok.str, tok.len);
+            import_edge(imp, p->node, to, imp->empty_label);
+            p->node = to;
+            p->state = DS_NODE;
+            return;
+        }
+        // subgraphs as endpoints are not supported, drop the edge
+        p->state = DS_STMT;
+        break;
+
+    case DS_PORT:
+        if (id) {
+            p->state = p->after_port;
+            return;
+        }
+        p->state = p->after_port;
+        dot_token(imp, tok);
+        return;
+
+    case DS_ATTR_KEY:
+        if (id) {
+            p->key = str_eq(tok.str, tok.len, "label")? AK_LABEL
+                : str_eq(tok.str, tok.len, "pos")? AK_POS : AK_OTHER;
+            p->state = DS_ATTR_EQ;
+        } else if (punct && tok.c == ']') {
+            // more attribute lists may follow
+            p->state = DS_NODE;
+        }
+        return;
+
+    case DS_ATTR_EQ:
+        if (punct && tok.c == '=') {
+            p->state = DS_ATTR_VALUE;
+            return;
+        }
+        p->state = DS_ATTR_KEY;
+        dot_token(imp, tok);
+        return;
+
+    case DS_ATTR_VALUE:
+        if (id) dot_attr(imp, p->key, tok.str, tok.len);
+        p->state = DS_ATTR_KEY;
+        if (!id) dot_token(imp, tok);
+        return;
+
+    case DS_GRAPH_ATTR:
+        p->state = DS_STMT;
+        if (id) return;
+        break;
+
+    case DS_SUBGRAPH:
+        p->state = DS_STMT;
+        if (id) return;
+        break;
+
+    case DS_STMT:
+        break;
+    }
+
+    // start of a statement
+    p->node = -1;
+    p->in_edges = false;
+    if (punct) {
+        if (tok.c == '{') p->depth++;
+        if (tok.c == '}') p->depth--;
+        if (tok.c == '[') p->state = DS_ATTR_KEY;     // after graph/node/edge
+        return;
+    }
+    if (!id) return;
+    if (p->depth == 0) return;                      // strict, (di)graph and name
+    if (str_eq_nocase(tok.str, tok.len, "subgraph")) {
+        p->state = DS_SUBGRAPH;
+        return;
+    }
+    if (str_eq_nocase(tok.str, tok.len, "graph") || str_eq_nocase(tok.str, tok.len, "node")
+            || str_eq_nocase(tok.str, tok.len, "edge")) {
+        return;
+    }
+    p->node = import_node(imp, tok.str, tok.len);
+    p->state = DS_NODE;
+}
+
+internal size_t import_dot(Importer *imp, char *buf, size_t len, bool eof)
+{
+    size_t pos = 0;
+    for (;;) {
+        DotToken tok = dot_next_token(imp, buf, len, &pos, eof);
+        if (tok.type == DT_MORE || tok.type == DT_END) break;
+        dot_token(imp, tok);
+    }
+    return pos;
+}
+
+//
+// GraphML
+//
+
+typedef struct XmlAttr {
+    const char *name;
+    size_t name_len;
+    const char *value;  // not NUL terminated
+    size_t value_len;
+} XmlAttr;
+
+// decode the predefined XML entities into the scratch arena. the result is not
+// NUL terminated when there is nothing to decode
+internal const char *xml_decode(Importer *imp, const char *s, size_t len, size_t *out_len)
+{
+    static const struct { const char *entity; char c; } entities[] = {
+        {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''},
+    };
+    *out_len = len;
+    if (!memchr(s, '&', len)) return (char *)s;
+
+    arena_set_allign(&imp->scratch, 1);
+    char *result = arena_push_size(&imp->scratch, len + 1);
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] == '&') {
+            size_t k = 0;
+            for (; k < ARRAYSIZE(entities); k++) {
+                size_t elen = strlen(entities[k].entity);
+                if (i + elen <= len && memcmp(s + i, entities[k].entity, elen) == 0) {
+                    result[n++] = entities[k].c;
+                    i += elen - 1;
+                    break;
+                }
+            }
+            if (k < ARRAYSIZE(entities)) continue;
+        }
+        result[n++] = s[i];
+    }
+    result[n] = '\0';
+    *out_len = n;
+    return result;
+}
+
+internal XmlAttr *xml_attr(XmlAttr *attrs, int num_attrs, const char *name)
+{
+    for (int i = 0; i < num_attrs; i++) {
+        if (str_eq(attrs[i].name, attrs[i].name_len, name)) return attrs + i;
+    }
+    return NULL;
+}
+
+internal bool xml_attr_eq(XmlAttr *attrs, int num_attrs, const char *name, const char *value)
+{
+    XmlAttr *a = xml_attr(attrs, num_attrs, name);
+    return a && str_eq(a->value, a->value_len, value);
+}
+
+internal void xml_attr_copy(XmlAttr *attr, char *dst, size_t size)
+{
+    size_t len = (attr->value_len < size - 1)? attr->value_len : size - 1;
+    memcpy(dst, attr->value, len);
+    dst[len] = '\0';
+}
+
+internal void graphml_text(Importer *imp, const char *s, size_t len)
+{
+    if (imp->gml.data != ID_NONE) da_append_many(imp->gml.text, s, len);
+}
+
+internal void graphml_data_end(Importer *imp)
+{
+    GraphmlParser *p = &imp->gml;
+    da_append(p->text, '\0');
+    char *s = p->text;
+    size_t len = da_size(p->text) - 1;
+    while (len > 0 && (*s == ' ' || *s == '\n' || *s == '\r' || *s == '\t')) {
+        s++;
+        len--;
+    }
+    while (len > 0 && (s[len - 1] == ' ' || s[len - 1] == '\n' || s[len - 1] == '\r'
+                || s[len - 1] == '\t')) {
+        len--;
+    }
+
+    if (p->data == ID_LABEL && p->edge >= 0) {
+        import_edge_label(imp, p->edge, s, len);
+    } else if ((p->data == ID_X || p->data == ID_Y) && p->node >= 0) {
+        float v = strtof(s, NULL);
+        Vector2 pos = imp->node_pos[p->node];
+        if (p->data == ID_X) pos.x = v; else pos.y = v;
+        import_node_pos(imp, p->node, pos.x, pos.y);
+    }
+    p->data = ID_NONE;
+}
+
+internal void graphml_tag(Importer *imp, const char *name, size_t name_len, XmlAttr *attrs,
+        int num_attrs, bool closing, bool self_closing)
+{
+    GraphmlParser *p = &imp->gml;
+
+    if (closing) {
+        if (str_eq(name, name_len, "node")) p->node = -1;
+        if (str_eq(name, name_len, "edge")) p->edge = -1;
+        if (str_eq(name, name_len, "data")) graphml_data_end(imp);
+        return;
+    }
+
+    if (str_eq(name, name_len, "key")) {
+        XmlAttr *id = xml_attr(attrs, num_attrs, "id");
+        if (!id) return;
+        bool for_edge = xml_attr_eq(attrs, num_attrs, "for", "edge")
+            || xml_attr_eq(attrs, num_attrs, "for", "all");
+        bool for_node = xml_attr_eq(attrs, num_attrs, "for", "node")
+            || xml_attr_eq(attrs, num_attrs, "for", "all");
+        if (for_edge && xml_attr_eq(attrs, num_attrs, "attr.name", "label"))
+            xml_attr_copy(id, p->label_key, sizeof(p->label_key));
+        if (for_node && xml_attr_eq(attrs, num_attrs, "attr.name", "x"))
+            xml_attr_copy(id, p->x_key, sizeof(p->x_key));
+        if (for_node && xml_attr_eq(attrs, num_attrs, "attr.name", "y"))
+            xml_attr_copy(id, p->y_key, sizeof(p->y_key));
+    } else if (str_eq(name, name_len, "node")) {
+        XmlAttr *id = xml_attr(attrs, num_attrs, "id");
+        if (!id) return;
+        int node = import_node(imp, id->value, id->value_len);
+        p->node = (self_closing)? -1 : node;
+    } else if (str_eq(name, name_len, "edge")) {
+        XmlAttr *source = xml_attr(attrs, num_attrs, "source");
+        XmlAttr *target = xml_attr(attrs, num_attrs, "target");
+        if (!source || !target) return;
+        int from = import_node(imp, source->value, source->value_len);
+        int to = import_node(imp, target->value, target->value_len);
+        int edge = import_edge(imp, from, to, imp->empty_label);
+        p->edge = (self_closing)? -1 : edge;
+    } else if (str_eq(name, name_len, "data") && !self_closing) {
+        XmlAttr *key = xml_attr(attrs, num_attrs, "key");
+        if (!key) return;
+        p->data = ID_NONE;
+        if (p->edge >= 0 && str_eq(key->value, key->value_len, p->label_key))
+            p->data = ID_LABEL;
+        if (p->node >= 0 && str_eq(key->value, key->value_len, p->x_key))
+            p->data = ID_X;
+        if (p->node >= 0 && str_eq(key->value, key->value_len, p->y_key))
+            p->data = ID_Y;
+        da_size(p->text) = 0;
+    }
+}
+
+// parse the tag between buf[0] = '<' and buf[len - 1] = '>'
+internal void graphml_parse_tag(Importer *imp, const char *buf, size_t len)
+{
+    const char *s = buf + 1;
+    const char *end = buf + len - 1;
+    bool closing = *s == '/';
+    if (closing) s++;
+    bool self_closing = end[-1] == '/';
+    if (self_closing) end--;
+
+    const char *name = s;
+    while (s < end && !strchr(" \t\r\n/", *s)) s++;
+    size_t name_len = s - name;
+
+    XmlAttr attrs[IMPORT_MAX_ATTRS];
+    int num_attrs = 0;
+    while (s < end && num_attrs < IMPORT_MAX_ATTRS) {
+        while (s < end && strchr(" \t\r\n", *s)) s++;
+        const char *attr_name = s;
+        while (s < end && !strchr(" \t\r\n=", *s)) s++;
+        size_t attr_name_len = s - attr_name;
+        while (s < end && strchr(" \t\r\n=", *s)) s++;
+        if (s >= end || (*s != '"' && *s != '\'')) break;
+        char quote = *s++;
+        const char *value = s;
+        while (s < end && *s != quote) s++;
+        XmlAttr *a = attrs + num_attrs++;
+        a->name = attr_name;
+        a->name_len = attr_name_len;
+        a->value = xml_decode(imp, value, s - value, &a->value_len);
+        s++;
+    }
+    graphml_tag(imp, name, name_len, attrs, num_attrs, closing, self_closing);
+}
+
+internal size_t import_graphml(Importer *imp, char *buf, size_t len, bool eof)
+{
+    size_t pos = 0;
+    while (pos < len) {
+        char *s = buf + pos;
+        size_t left = len - pos;
+
+        if (*s != '<') {
+            char *lt = memchr(s, '<', left);
+            if (!lt && !eof) break;
+            size_t text_len = (lt)? (size_t)(lt - s) : left;
+            if (imp->gml.data != ID_NONE) {
+                size_t decoded_len;
+                const char *text = xml_decode(imp, s, text_len, &decoded_len);
+                graphml_text(imp, text, decoded_len);
+            }
+            pos += text_len;
+            continue;
+        }
+
+        // markup that may contain '>'
+        if (left < 9 && !eof) break;
+        const char *close = ">";
+        size_t skip = 0;
+        if (left >= 4 && memcmp(s, "<!--", 4) == 0) {
+            close = "-->";
+        } else if (left >= 9 && memcmp(s, "<![CDATA[", 9) == 0) {
+            close = "]]>";
+            skip = 9;
+        }
+
+        size_t close_len = strlen(close);
+        size_t end = 1;
+        char quote = 0;
+        for (; end + close_len <= left; end++) {
+            if (close_len == 1 && (s[end] == '"' || s[end] == '\'')) {
+                if (!quote) quote = s[end];
+                else if (quote == s[end]) quote = 0;
+            }
+            if (!quote && memcmp(s + end, close, close_len) == 0) break;
+        }
+        if (end + close_len > left) {
+            if (!eof) break;
+            imp->error = "unterminated XML markup";
+            return pos;
+        }
+        end += close_len;
+
+        if (skip) {
+            graphml_text(imp, s + skip, end - skip - close_len);
+        } else if (s[1] != '!' && s[1] != '?') {
+            graphml_parse_tag(imp, s, end);
+        }
+        pos += end;
+    }
+    return pos;
+}
+
+//
+// driver
+//
+
+bool import_begin(Importer *imp, const char *path, enum ImportFormat format)
+{
+    *imp = (Importer){0};
+    imp->file = fopen(path, "rb");
+    if (!imp->file) {
+        TraceLog(LOG_WARNING, "IMPORT: could not open %s", path);
+        return false;
+    }
+    fseek(imp->file, 0, SEEK_END);
+    long size = ftell(imp->file);
+    fseek(imp->file, 0, SEEK_SET);
+    imp->file_size = (size > 0)? size : 0;
+
+    imp->format = format;
+    imp->status = IS_RUNNING;
+    imp->buf = malloc(IMPORT_CHUNK_SIZE);
+    assert(imp->buf);
+    imp->empty_label = label_intern(&imp->labels, "");
+    imp->dot.node = -1;
+    imp->gml.node = -1;
+    imp->gml.edge = -1;
+    return true;
+}
+
+// parse the next chunk into `out`, to be freed with import_batch_free(). the
+// batch may be empty
+void import_chunk(Importer *imp, ImportBatch *out)
+{
+    assert(imp->status == IS_RUNNING);
+    size_t n = fread(imp->buf + imp->buf_len, 1, IMPORT_CHUNK_SIZE - imp->buf_len, imp->file);
+    imp->buf_len += n;
+    if (ferror(imp->file)) {
+        imp->error = "read error";
+        imp->status = IS_ERROR;
+        import_flush(imp, out);
+        return;
+    }
+    imp->eof = feof(imp->file);
+
+    arena_reset(&imp->scratch);
+    size_t used = 0;
+    switch (imp->format) {
+    case IF_EDGE_LIST: used = import_edge_list(imp, imp->buf, imp->buf_len, imp->eof); break;
+    case IF_DOT:       used = import_dot(imp, imp->buf, imp->buf_len, imp->eof); break;
+    case IF_GRAPHML:   used = import_graphml(imp, imp->buf, imp->buf_len, imp->eof); break;
+    }
+
+    memmove(imp->buf, imp->buf + used, imp->buf_len - used);
+    imp->buf_len -= used;
+    imp->bytes_done += used;
+    import_flush(imp, out);
+
+    if (imp->error) {
+        imp->status = IS_ERROR;
+    } else if (imp->eof) {
+        imp->status = IS_DONE;
+    } else if (imp->buf_len == IMPORT_CHUNK_SIZE) {
+        imp->error = "line or token longer than a chunk";
+        imp->status = IS_ERROR;
+    }
+}
+
+// append the batch to `g`, which holds the batches made before it. `label_map`
+// maps the label ids of the importer to those of `g` and grows with every batch
+void import_batch_apply(Graph *g, ImportBatch *b, int **label_map)
+{
+    const char *str = b->label_chars;
+    for (size_t i = 0; i < da_size(b->label_len); i++) {
+        da_append(*label_map, label_intern_len(&g->labels, str, b->label_len[i]));
+        str += b->label_len[i];
+    }
+
+    int *map = *label_map;
+    for (size_t i = 0; i < da_size(b->edge_label); i++)
+        b->edge_label[i] = map[b->edge_label[i]];
+    graph_add_nodes(g, b->node_x, b->node_y, da_size(b->node_x));
+    graph_add_edges(g, b->edge_from, b->edge_to, b->edge_c1, b->edge_c2, b->edge_loffset,
+            b->edge_label, da_size(b->edge_from));
+
+    for (size_t i = 0; i < da_size(b->moved_node); i++)
+        graph_set_node_pos(g, b->moved_node[i], b->moved_pos[i]);
+    for (size_t i = 0; i < da_size(b->relabeled_edge); i++)
+        g->label[b->relabeled_edge[i]] = map[b->relabeled_label[i]];
+}
+
+void import_batch_free(ImportBatch *b)
+{
+    da_free(b->node_x);
+    da_free(b->node_y);
+    da_free(b->edge_from);
+    da_free(b->edge_to);
+    da_free(b->edge_c1);
+    da_free(b->edge_c2);
+    da_free(b->edge_loffset);
+    da_free(b->edge_label);
+    da_free(b->label_chars);
+    da_free(b->label_len);
+    da_free(b->moved_node);
+    da_free(b->moved_pos);
+    da_free(b->relabeled_edge);
+    da_free(b->relabeled_label);
+    *b = (ImportBatch){0};
+}
+
+// parse chunks into imp->g for about `budget_ms` milliseconds
+enum ImportStatus import_step(Importer *imp, double budget_ms)
+{
+    double start = now_ms();
+    while (imp->status == IS_RUNNING) {
+        ImportBatch b;
+        import_chunk(imp, &b);
+        import_batch_apply(&imp->g, &b, &imp->label_map);
+        import_batch_free(&b);
+        if (now_ms() - start > budget_ms) break;
+    }
+    return imp->status;
+}
+
+float import_progress(Importer *imp)
+{
+    if (imp->status == IS_DONE || imp->file_size == 0) return 1.0f;
+    return (float)imp->bytes_done/imp->file_size;
+}
+
+// frees everything but imp->g, that is moved to `g`
+void import_end(Importer *imp, Graph *g)
+{
+    if (g) {
+        *g = imp->g;
+    } else {
+        graph_free(&imp->g);
+    }
+    if (imp->file) fclose(imp->file);
+    free(imp->buf);
+    arena_free(&imp->scratch);
+    label_table_free(&imp->names);
+    label_table_free(&imp->labels);
+    da_free(imp->name_node);
+    da_free(imp->number_node);
+    da_free(imp->sparse_number);
+    da_free(imp->sparse_node);
+    da_free(imp->node_pos);
+    import_batch_free(&imp->batch);
+    da_free(imp->label_map);
+    da_free(imp->gml.text);
+    *imp = (Importer){0};
+}
+
+// import the whole file at once into the empty graph `g`
+bool import_file(Graph *g, const char *path, enum ImportFormat format)
+{
+    Importer imp;
+    if (!import_begin(&imp, path, format)) return false;
+    while (import_step(&imp, INFINITY) == IS_RUNNING) {}
+    bool ok = imp.status == IS_DONE;
+    if (!ok) TraceLog(LOG_WARNING, "IMPORT: %s: %s", path, imp.error);
+    import_end(&imp, (ok)? g : NULL);
+    return ok;
+}
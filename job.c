@@ -0,0 +1,247 @@
+// Job pool
+//
+// data-parallel loops over a fixed set of threads: job_parallel_for() splits
+// [0, n) into ranges run by the calling thread and the workers, and returns
+// once all of them are done, so everything written by the jobs is visible to
+// the caller afterwards.
+//
+// every thread has a work-stealing deque of ranges (Chase-Lev, with the C11
+// memory orders of Lê et al. 2013). a thread takes the most recent range from
+// the bottom of its own deque and, while it is longer than the grain, pushes
+// its upper half back and keeps the lower half. idle threads steal from the top
+// of the other deques, where the largest ranges are, and split them the same
+// way. the loop starts as a single range on the caller's deque.
+//
+// with a single thread, or a loop shorter than its grain, the job runs on the
+// calling thread as one call over [0, n): the same as a plain loop.
+//
+// every thread also has a scratch arena, job_scratch(), for what a job makes
+// for the caller: it is reset when the thread runs its first range of a loop,
+// so what a job pushed there stays valid until the next loop.
+//
+// NOTE: loops don't nest, a job must not call job_parallel_for().
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#define JOB_MAX_THREADS 64
+#define JOB_DEQUE_SIZE 64           // power of two, more than the splits of an int range
+
+typedef void JobFn(void *data, int begin, int end);
+
+typedef struct JobDeque {
+    _Alignas(64) atomic_long top;           // stolen from here
+    _Alignas(64) atomic_long bottom;        // the owner pushes and takes here
+    _Atomic uint64_t ranges[JOB_DEQUE_SIZE];
+} JobDeque;
+
+typedef struct JobPool {
+    int num_threads;        // the calling thread included, 0 or 1 when serial
+    pthread_t *threads;
+    JobDeque *deques;       // per thread, deques[0] is the caller's
+
+    // the loop in progress
+    JobFn *fn;
+    void *data;
+    int grain;
+    atomic_int pending;     // items not done yet
+    atomic_uint loop;       // number of the loop, for the scratch arenas
+
+    pthread_mutex_t mutex;  // idle workers wait for a new loop
+    pthread_cond_t wake;
+    unsigned generation;    // of the loop, under `mutex`
+    bool quit;
+} JobPool;
+
+typedef struct JobWorker {
+    JobPool *pool;
+    int id;
+} JobWorker;
+
+global_variable JobPool global_jobs;
+
+global_variable _Thread_local Arena job_arena;
+global_variable _Thread_local unsigned job_arena_loop;
+
+// scratch arena of the calling thread
+Arena *job_scratch(void)
+{
+    return &job_arena;
+}
+
+// the thread starts working on loop `loop`
+internal void job_scratch_enter(unsigned loop)
+{
+    if (job_arena_loop == loop) return;
+    arena_reset(&job_arena);
+    job_arena_loop = loop;
+}
+
+internal uint64_t job_range(int begin, int end)
+{
+    return (uint64_t)(uint32_t)begin << 32 | (uint32_t)end;
+}
+
+internal void job_deque_push(JobDeque *q, uint64_t range)
+{
+    long b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&q->top, memory_order_acquire);
+    assert(b - t < JOB_DEQUE_SIZE);
+    atomic_store_explicit(&q->ranges[b & (JOB_DEQUE_SIZE - 1)], range, memory_order_relaxed);
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_release);
+}
+
+// by the owner
+internal bool job_deque_take(JobDeque *q, uint64_t *range)
+{
+    long b = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&q->top, memory_order_relaxed);
+    if (t > b) {
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+        return false;
+    }
+    *range = atomic_load_explicit(&q->ranges[b & (JOB_DEQUE_SIZE - 1)], memory_order_relaxed);
+    if (t < b) return true;
+
+    // the last one, race with the thieves
+    bool won = atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+            memory_order_seq_cst, memory_order_relaxed);
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    return won;
+}
+
+// by the other threads
+internal bool job_deque_steal(JobDeque *q, uint64_t *range)
+{
+    long t = atomic_load_explicit(&q->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+    if (t >= b) return false;
+    *range = atomic_load_explicit(&q->ranges[t & (JOB_DEQUE_SIZE - 1)], memory_order_relaxed);
+    return atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+            memory_order_seq_cst, memory_order_relaxed);
+}
+
+// run ranges of the current loop on thread `id` until the loop is done
+internal void job_run(JobPool *p, int id)
+{
+    JobDeque *own = p->deques + id;
+    while (atomic_load_explicit(&p->pending, memory_order_acquire) > 0) {
+        uint64_t range;
+        bool found = job_deque_take(own, &range);
+        for (int i = 1; !found && i < p->num_threads; i++)
+            found = job_deque_steal(p->deques + (id + i) % p->num_threads, &range);
+        if (!found) {
+            sched_yield();
+            continue;
+        }
+        // a range is only pushed once its loop is numbered, and the loop can't
+        // end before the range is done
+        job_scratch_enter(atomic_load_explicit(&p->loop, memory_order_acquire));
+
+        int begin = range >> 32;
+        int end = (int)(uint32_t)range;
+        while (end - begin > p->grain) {
+            int mid = begin + (end - begin)/2;
+            job_deque_push(own, job_range(mid, end));
+            end = mid;
+        }
+        p->fn(p->data, begin, end);
+        atomic_fetch_sub_explicit(&p->pending, end - begin, memory_order_release);
+    }
+}
+
+internal void *job_worker_main(void *arg)
+{
+    JobWorker *w = arg;
+    JobPool *p = w->pool;
+    unsigned seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&p->mutex);
+        while (p->generation == seen && !p->quit)
+            pthread_cond_wait(&p->wake, &p->mutex);
+        seen = p->generation;
+        bool quit = p->quit;
+        pthread_mutex_unlock(&p->mutex);
+        if (quit) break;
+        job_run(p, w->id);
+    }
+    arena_free(&job_arena);
+    free(w);
+    return NULL;
+}
+
+// start `num_threads - 1` workers, 0 for one thread per core
+void job_pool_init(JobPool *p, int num_threads)
+{
+    *p = (JobPool){0};
+    if (num_threads <= 0) num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > JOB_MAX_THREADS) num_threads = JOB_MAX_THREADS;
+
+    p->deques = calloc(num_threads, sizeof(*p->deques));
+    p->threads = calloc(num_threads, sizeof(*p->threads));
+    assert(p->deques && p->threads);
+    pthread_mutex_init(&p->mutex, NULL);
+    pthread_cond_init(&p->wake, NULL);
+    p->num_threads = 1;
+    for (int i = 1; i < num_threads; i++) {
+        JobWorker *w = malloc(sizeof(*w));
+        assert(w);
+        *w = (JobWorker){p, i};
+        if (pthread_create(p->threads + i, NULL, job_worker_main, w) != 0) {
+            TraceLog(LOG_WARNING, "JOBS: could not start worker %d", i);
+            free(w);
+            break;
+        }
+        p->num_threads++;
+    }
+    TraceLog(LOG_INFO, "JOBS: %d threads", p->num_threads);
+}
+
+void job_pool_free(JobPool *p)
+{
+    if (!p->deques) return;
+    pthread_mutex_lock(&p->mutex);
+    p->quit = true;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->mutex);
+    for (int i = 1; i < p->num_threads; i++)
+        pthread_join(p->threads[i], NULL);
+    pthread_mutex_destroy(&p->mutex);
+    pthread_cond_destroy(&p->wake);
+    free(p->threads);
+    free(p->deques);
+    arena_free(&job_arena);
+    *p = (JobPool){0};
+}
+
+// call fn(data, begin, end) over ranges covering [0, n), at most `grain` long
+// unless run serially, and wait for all of them
+void job_parallel_for(JobPool *p, int n, int grain, JobFn *fn, void *data)
+{
+    if (n <= 0) return;
+    unsigned loop = atomic_fetch_add_explicit(&p->loop, 1, memory_order_release) + 1;
+    if (p->num_threads <= 1 || n <= grain) {
+        job_scratch_enter(loop);
+        fn(data, 0, n);
+        return;
+    }
+
+    p->fn = fn;
+    p->data = data;
+    p->grain = (grain > 0)? grain : 1;
+    atomic_store_explicit(&p->pending, n, memory_order_relaxed);
+    job_deque_push(p->deques, job_range(0, n));
+
+    pthread_mutex_lock(&p->mutex);
+    p->generation++;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->mutex);
+
+    job_run(p, 0);
+}
@@ -0,0 +1,191 @@
+// Edit journal
+//
+// undo and redo of the interactive edits. an entry is the value a field had
+// before and after one edit, a whole drag makes a single entry. the entries are
+// linked both ways, undo and redo walk the list one entry per step.
+//
+// entries live in arenas: recording after some undos rewinds the arena to the
+// first entry undone, so the redo branch is dropped for free. to bound the
+// memory, the history is split in two generations of at most
+// JOURNAL_GEN_ENTRIES entries or JOURNAL_GEN_BYTES bytes, each in its own
+// arena. when the current one is full the other, oldest, is reset and recording
+// goes on there: the history keeps between one and two generations of the last
+// edits. a reset keeps the largest block of the arena for the next generation
+// and frees the others, see arena_reset().
+//
+// moving the selection makes one entry with the ids of the nodes moved and the
+// offset.
+
+#define JOURNAL_GEN_ENTRIES 65536
+#define JOURNAL_GEN_BYTES (8 << 20)
+
+enum JournalKind {
+    JK_NODE_POS,
+    JK_LOFFSET,
+    JK_CTRL1,
+    JK_CTRL2,
+    JK_MOVE_NODES,      // `ids` moved by `after`
+};
+
+typedef struct JournalEntry JournalEntry;
+struct JournalEntry {
+    JournalEntry *prev;
+    JournalEntry *next;     // NULL for the last one
+    Arena_Mark mark;        // of its arena before it was pushed
+    uint8_t kind;
+    uint8_t gen;
+    int index;              // in its generation
+    int id;                 // node or edge, -1 for JK_MOVE_NODES
+    Vector2 before;
+    Vector2 after;
+    int *ids;               // of JK_MOVE_NODES
+    int num_ids;
+};
+
+typedef struct Journal {
+    Arena gens[2];
+    JournalEntry *gen_first[2];
+    int gen_entries[2];
+    size_t gen_bytes[2];
+    int cur;                    // generation recorded to
+    JournalEntry *first;        // the oldest entry kept
+    JournalEntry *applied;      // the last entry not undone, NULL when all are
+} Journal;
+
+inline internal size_t journal_entry_size(JournalEntry *e)
+{
+    return sizeof(*e) + e->num_ids*sizeof(*e->ids);
+}
+
+// drop the entries from `e` on, which come after `j->applied`
+internal void journal_truncate(Journal *j, JournalEntry *e)
+{
+    for (JournalEntry *d = e; d && d->gen == e->gen; d = d->next)
+        j->gen_bytes[e->gen] -= journal_entry_size(d);
+    if (e->gen != j->cur) {
+        arena_reset(&j->gens[j->cur]);
+        j->gen_entries[j->cur] = 0;
+        j->gen_bytes[j->cur] = 0;
+        j->cur = e->gen;
+    }
+    arena_rewind(&j->gens[e->gen], e->mark);
+    j->gen_entries[e->gen] = e->index;
+    if (j->applied) {
+        j->applied->next = NULL;
+    } else {
+        j->first = NULL;
+    }
+}
+
+internal JournalEntry *journal_push(Journal *j, enum JournalKind kind, int id, Vector2 before,
+        Vector2 after, size_t extra)
+{
+    JournalEntry *redo = (j->applied)? j->applied->next : j->first;
+    if (redo) journal_truncate(j, redo);
+
+    if (j->gen_entries[j->cur] == JOURNAL_GEN_ENTRIES || j->gen_bytes[j->cur] >= JOURNAL_GEN_BYTES) {
+        int old = 1 - j->cur;
+        arena_reset(&j->gens[old]);
+        j->gen_entries[old] = 0;
+        j->gen_bytes[old] = 0;
+        j->first = j->gen_first[j->cur];
+        j->first->prev = NULL;
+        j->cur = old;
+    }
+
+    Arena *a = &j->gens[j->cur];
+    Arena_Mark mark = arena_snapshot(a);
+    arena_set_allign(a, 8);
+    JournalEntry *e = arena_push_size(a, sizeof(*e));
+    *e = (JournalEntry){
+        .prev = j->applied,
+        .mark = mark,
+        .kind = kind,
+        .gen = j->cur,
+        .index = j->gen_entries[j->cur]++,
+        .id = id,
+        .before = before,
+        .after = after,
+    };
+    if (e->index == 0) j->gen_first[j->cur] = e;
+    if (extra) e->ids = arena_push_size(a, extra);
+    j->gen_bytes[j->cur] += sizeof(*e) + extra;
+    if (j->applied) {
+        j->applied->next = e;
+    } else {
+        j->first = e;
+    }
+    j->applied = e;
+    return e;
+}
+
+// record an edit, dropping the ones undone
+void journal_record(Journal *j, enum JournalKind kind, int id, Vector2 before, Vector2 after)
+{
+    journal_push(j, kind, id, before, after, 0);
+}
+
+// record the move of `n` nodes by `delta`
+void journal_record_move(Journal *j, int *ids, int n, Vector2 delta)
+{
+    JournalEntry *e = journal_push(j, JK_MOVE_NODES, -1, (Vector2){0}, delta, n*sizeof(*ids));
+    memcpy(e->ids, ids, n*sizeof(*ids));
+    e->num_ids = n;
+}
+
+// the edit to revert, to its `before` value, NULL when there is none
+JournalEntry *journal_undo(Journal *j)
+{
+    JournalEntry *e = j->applied;
+    if (e) j->applied = e->prev;
+    return e;
+}
+
+// the edit to apply again, to its `after` value, NULL when there is none
+JournalEntry *journal_redo(Journal *j)
+{
+    JournalEntry *e = (j->applied)? j->applied->next : j->first;
+    if (e) j->applied = e;
+    return e;
+}
+
+// follow the ids of the graph after graph_compact(). removing items clears the
+// history, so the entries only refer to items kept
+void journal_remap(Journal *j, int *node_map, int *edge_map)
+{
+    for (JournalEntry *e = j->first; e; e = e->next) {
+        switch ((enum JournalKind)e->kind) {
+        case JK_NODE_POS:
+            e->id = node_map[e->id];
+            break;
+        case JK_LOFFSET:
+        case JK_CTRL1:
+        case JK_CTRL2:
+            e->id = edge_map[e->id];
+            break;
+        case JK_MOVE_NODES:
+            for (int i = 0; i < e->num_ids; i++) e->ids[i] = node_map[e->ids[i]];
+            break;
+        }
+    }
+}
+
+// forget every entry, the memory is kept
+void journal_clear(Journal *j)
+{
+    for (int i = 0; i < 2; i++) {
+        arena_reset(&j->gens[i]);
+        j->gen_entries[i] = 0;
+        j->gen_bytes[i] = 0;
+    }
+    j->cur = 0;
+    j->first = NULL;
+    j->applied = NULL;
+}
+
+void journal_free(Journal *j)
+{
+    arena_free(&j->gens[0]);
+    arena_free(&j->gens[1]);
+    *j = (Journal){0};
+}
@@ -0,0 +1,175 @@
+// Interned label strings
+//
+// every distinct string is stored once in an arena and identified by the index
+// of its entry. the table is an open addressing hash over the entries, and each
+// entry caches the size of the text measured with the last font and size it was
+// asked for, so MeasureTextEx runs once per distinct label instead of once per
+// edge.
+
+typedef struct LabelEntry {
+    const char *str;
+    uint32_t len;
+    uint32_t hash;
+
+    // cached metrics
+    unsigned int font_id;   // texture id of the font
+    float font_size;        // 0 when nothing is cached
+    float spacing;
+    Vector2 size;
+} LabelEntry;
+
+typedef struct LabelTable {
+    Arena arena;            // string storage
+    LabelEntry *entries;
+    int *slots;             // entry index, or -1 when empty
+    size_t num_slots;       // power of two
+} LabelTable;
+
+#define LABEL_TABLE_INITIAL_SLOTS 64
+#define LABEL_INTERN_BATCH 64
+
+internal uint32_t label_hash(const char *str, size_t len)
+{
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)str[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+internal void label_table_grow(LabelTable *t)
+{
+    size_t num_slots = (t->num_slots)? 2*t->num_slots : LABEL_TABLE_INITIAL_SLOTS;
+    while (2*(da_size(t->entries) + 1) > num_slots) num_slots *= 2;
+    int *slots = malloc(num_slots*sizeof(*slots));
+    assert(slots);
+    for (size_t i = 0; i < num_slots; i++) slots[i] = -1;
+
+    for (size_t i = 0; i < da_size(t->entries); i++) {
+        size_t s = t->entries[i].hash & (num_slots - 1);
+        while (slots[s] >= 0) s = (s + 1) & (num_slots - 1);
+        slots[s] = i;
+    }
+
+    free(t->slots);
+    t->slots = slots;
+    t->num_slots = num_slots;
+}
+
+internal int label_intern_hashed(LabelTable *t, const char *str, size_t len, uint32_t hash)
+{
+    if (2*(da_size(t->entries) + 1) > t->num_slots)
+        label_table_grow(t);
+
+    size_t s = hash & (t->num_slots - 1);
+    while (t->slots[s] >= 0) {
+        LabelEntry *e = t->entries + t->slots[s];
+        if (e->hash == hash && e->len == len && memcmp(e->str, str, len) == 0)
+            return t->slots[s];
+        s = (s + 1) & (t->num_slots - 1);
+    }
+
+    arena_set_allign(&t->arena, 1);
+    char *copy = arena_push_size(&t->arena, len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+
+    LabelEntry entry = {.str = copy, .len = len, .hash = hash};
+    da_append(t->entries, entry);
+    t->slots[s] = da_size(t->entries) - 1;
+    return t->slots[s];
+}
+
+// `str` doesn't need to be NUL terminated
+int label_intern_len(LabelTable *t, const char *str, size_t len)
+{
+    return label_intern_hashed(t, str, len, label_hash(str, len));
+}
+
+// intern `n` strings at once: with big tables every lookup misses the cache on
+// the slot, the entry and the string, here the misses of the whole batch are
+// overlapped by prefetching each level for all the strings before the next one
+internal void label_intern_batch(LabelTable *t, const char **strs, const size_t *lens, int *ids,
+        int n)
+{
+    assert(n <= LABEL_INTERN_BATCH);
+    while (2*(da_size(t->entries) + n) > t->num_slots)
+        label_table_grow(t);
+
+    size_t mask = t->num_slots - 1;
+    uint32_t hashes[LABEL_INTERN_BATCH];
+    for (int i = 0; i < n; i++) {
+        hashes[i] = label_hash(strs[i], lens[i]);
+        __builtin_prefetch(t->slots + (hashes[i] & mask));
+    }
+    for (int i = 0; i < n; i++) {
+        int id = t->slots[hashes[i] & mask];
+        ids[i] = id;
+        if (id >= 0) __builtin_prefetch(t->entries + id);
+    }
+    for (int i = 0; i < n; i++) {
+        if (ids[i] >= 0) __builtin_prefetch(t->entries[ids[i]].str);
+    }
+    for (int i = 0; i < n; i++)
+        ids[i] = label_intern_hashed(t, strs[i], lens[i], hashes[i]);
+}
+
+void label_intern_many(LabelTable *t, const char **strs, const size_t *lens, int *ids, int n)
+{
+    for (int k = 0; k < n; k += LABEL_INTERN_BATCH) {
+        int m = (n - k < LABEL_INTERN_BATCH)? n - k : LABEL_INTERN_BATCH;
+        label_intern_batch(t, strs + k, lens + k, ids + k, m);
+    }
+}
+
+int label_intern(LabelTable *t, const char *str)
+{
+    return label_intern_len(t, str, strlen(str));
+}
+
+// add a string stored outside of the table (e.g. in a mapped file), that must
+// outlive it and must not be in the table already. the slots are rebuilt on the
+// next label_intern()
+int label_add_external(LabelTable *t, const char *str, uint32_t len, uint32_t hash)
+{
+    LabelEntry entry = {.str = str, .len = len, .hash = hash};
+    da_append(t->entries, entry);
+    free(t->slots);
+    t->slots = NULL;
+    t->num_slots = 0;
+    return da_size(t->entries) - 1;
+}
+
+inline internal const char *label_str(LabelTable *t, int id)
+{
+    return t->entries[id].str;
+}
+
+Vector2 label_measure(LabelTable *t, int id, Font font, float font_size, float spacing)
+{
+    LabelEntry *e = t->entries + id;
+    if (e->font_id != font.texture.id || e->font_size != font_size || e->spacing != spacing) {
+        e->size      = MeasureTextEx(font, e->str, font_size, spacing);
+        e->font_id   = font.texture.id;
+        e->font_size = font_size;
+        e->spacing   = spacing;
+    }
+    return e->size;
+}
+
+// the size cached by the last label_measure(), which only reads the entry, so
+// jobs can call it while the main thread doesn't measure
+inline internal Vector2 label_measured(LabelTable *t, int id)
+{
+    return t->entries[id].size;
+}
+
+void label_table_free(LabelTable *t)
+{
+    arena_free(&t->arena);
+    da_free(t->entries);
+    free(t->slots);
+    *t = (LabelTable){0};
+}
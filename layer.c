@@ -0,0 +1,131 @@
+// Layer cache
+//
+// the graph drawn once in a render texture and composited every frame while
+// only the camera position or the hovered item change. the texture covers the
+// graphics area with LAYER_MARGIN pixels more on each side, so a pan of up to
+// the margin moves the texture instead of drawing the graph again. the hovered
+// and dragged items are drawn over it every frame, see app_draw_overlay().
+//
+// the layer is drawn again when the key it was drawn with changes: the zoom,
+// which the level of detail and the widths depend on, the versions of the
+// geometry cache and of the selection, the size of the area and the drawing
+// options. the edits that bump no version, removing or recoloring items, call
+// layer_invalidate(). while the key changes every frame, dragging or zooming,
+// the graph is better drawn directly: the texture is larger than the screen and
+// would be thrown away on the next frame, so layer_stable() waits for a frame
+// with the same key.
+//
+//     if (!layer_stable(&layer, key)) {
+//         draw(camera);
+//     } else {
+//         if (!layer_fresh(&layer, key, camera, area)) {
+//             Camera2D cam = layer_begin(&layer, key, camera, area);
+//             draw(cam);
+//             layer_end();
+//         }
+//         layer_draw(&layer, camera);
+//     }
+
+#define LAYER_MARGIN 256    // pixels around the graphics area
+
+typedef struct LayerKey {
+    float zoom;
+    float rotation;
+    uint32_t geo_version;   // GeoCache.version
+    uint32_t sel_version;   // Selection.version
+    int width, height;      // of the graphics area
+    bool show_control_pts;
+    bool batched;
+} LayerKey;
+
+typedef struct Layer {
+    RenderTexture2D target;
+    LayerKey key;           // the texture was drawn with
+    LayerKey last;          // of the previous frame
+    Camera2D camera;
+    bool valid;
+    int redraws;
+} Layer;
+
+internal bool layer_key_equal(LayerKey a, LayerKey b)
+{
+    return a.zoom == b.zoom && a.rotation == b.rotation && a.geo_version == b.geo_version
+        && a.sel_version == b.sel_version && a.width == b.width && a.height == b.height
+        && a.show_control_pts == b.show_control_pts && a.batched == b.batched;
+}
+
+// the key is the one of the previous frame
+bool layer_stable(Layer *l, LayerKey key)
+{
+    bool stable = layer_key_equal(l->last, key);
+    l->last = key;
+    return stable;
+}
+
+// screen position of the top left corner of the texture, seen through `camera`
+internal Vector2 layer_position(Layer *l, Camera2D camera)
+{
+    Vector2 corner = GetScreenToWorld2D((Vector2){0, 0}, l->camera);
+    Vector2 p = GetWorldToScreen2D(corner, camera);
+    return (Vector2){roundf(p.x), roundf(p.y)};
+}
+
+// the texture can be composited as it is in `area` seen through `camera`
+bool layer_fresh(Layer *l, LayerKey key, Camera2D camera, Rectangle area)
+{
+    if (!l->valid || !layer_key_equal(l->key, key)) return false;
+    Vector2 p = layer_position(l, camera);
+    return p.x <= area.x && p.x >= area.x - 2*LAYER_MARGIN
+        && p.y <= area.y && p.y >= area.y - 2*LAYER_MARGIN;
+}
+
+// start drawing the layer of `area` seen through `camera`, with the returned
+// camera. the texture is cleared to the background
+Camera2D layer_begin(Layer *l, LayerKey key, Camera2D camera, Rectangle area)
+{
+    int width = (int)area.width + 2*LAYER_MARGIN;
+    int height = (int)area.height + 2*LAYER_MARGIN;
+    if (l->target.id == 0 || l->target.texture.width != width || l->target.texture.height != height) {
+        if (l->target.id) UnloadRenderTexture(l->target);
+        l->target = LoadRenderTexture(width, height);
+    }
+    l->key = key;
+    l->camera = camera;
+    l->camera.offset = Vector2Subtract(camera.offset,
+            (Vector2){area.x - LAYER_MARGIN, area.y - LAYER_MARGIN});
+    l->valid = true;
+    l->redraws++;
+    BeginTextureMode(l->target);
+    ClearBackground(BACKGROUND_COLOR);
+    return l->camera;
+}
+
+void layer_end(void)
+{
+    EndTextureMode();
+}
+
+// composite the layer, render textures are stored upside down. the texture is
+// copied without blending: the translucent items drawn in it are already blended
+// over the background, but the alpha blend scaled the alpha of their pixels too,
+// and blending them again would let the background through a second time
+void layer_draw(Layer *l, Camera2D camera)
+{
+    Texture2D t = l->target.texture;
+    rlSetBlendFactors(RL_ONE, RL_ZERO, RL_FUNC_ADD);
+    BeginBlendMode(BLEND_CUSTOM);
+    DrawTextureRec(t, (Rectangle){0, 0, (float)t.width, -(float)t.height},
+            layer_position(l, camera), WHITE);
+    EndBlendMode();
+}
+
+inline internal void layer_invalidate(Layer *l)
+{
+    l->valid = false;
+}
+
+void layer_free(Layer *l)
+{
+    if (l->target.id) UnloadRenderTexture(l->target);
+    *l = (Layer){0};
+}
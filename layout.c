@@ -0,0 +1,244 @@
+// Force-directed layout
+//
+// Fruchterman-Reingold: every pair of nodes repels with k²/d, every edge pulls
+// its nodes together with d²/k, a weak gravity keeps disconnected parts close,
+// and each iteration moves the nodes at most by a temperature that cools down
+// until the layout settles. `k` is the ideal edge length.
+//
+// the repulsion uses a Barnes-Hut quadtree rebuilt every iteration: seen from
+// far enough (cell size / distance < LAYOUT_THETA) a cell acts as one body of
+// its mass placed at its center of mass, so an iteration is O(N log N) instead
+// of O(N²). the cells live in one array, the 4 children of a cell are next to
+// each other.
+//
+// the repulsion of each node is computed in jobs of LAYOUT_JOB_GRAIN nodes over
+// the job pool. layout_step() runs iterations for a time budget, to be called
+// once per frame.
+
+#define LAYOUT_IDEAL_LENGTH 200.0f
+#define LAYOUT_THETA 0.9f
+#define LAYOUT_GRAVITY 0.1f
+#define LAYOUT_COOLING 0.95f
+#define LAYOUT_MIN_TEMPERATURE 2.0f     // settled below
+#define LAYOUT_MAX_DEPTH 24             // nodes closer than size/2^depth share a leaf
+#define LAYOUT_JOB_GRAIN 1024
+
+typedef struct QuadCell {
+    float x, y;         // center of mass, a sum while the tree is built
+    float mass;         // number of nodes
+    float min_x, min_y;
+    float size;
+    int child;          // first of the 4 children, -1 for leaves
+    int body;           // first node of a leaf, -1 when empty
+} QuadCell;
+
+typedef struct Layout {
+    QuadCell *cells;
+    float *dx;          // displacement of the iteration, per node
+    float *dy;
+    float temperature;  // 0 when settled
+    int iterations;
+} Layout;
+
+internal int quad_new_cell(Layout *l, float min_x, float min_y, float size)
+{
+    da_append(l->cells, ((QuadCell){0, 0, 0, min_x, min_y, size, -1, -1}));
+    return da_size(l->cells) - 1;
+}
+
+internal void quad_insert(Layout *l, Graph *g, int node)
+{
+    float x = g->x[node];
+    float y = g->y[node];
+    int c = 0;
+    for (int depth = 0; ; depth++) {
+        QuadCell *cell = l->cells + c;
+        cell->x += x;
+        cell->y += y;
+        cell->mass += 1;
+        if (cell->child < 0) {
+            if (cell->body < 0) {
+                cell->body = node;
+                return;
+            }
+            if (depth == LAYOUT_MAX_DEPTH) return;
+
+            // split, the node already here moves to its quadrant
+            int body = cell->body;
+            float half = cell->size/2;
+            float min_x = cell->min_x;
+            float min_y = cell->min_y;
+            int child = quad_new_cell(l, min_x, min_y, half);
+            quad_new_cell(l, min_x + half, min_y, half);
+            quad_new_cell(l, min_x, min_y + half, half);
+            quad_new_cell(l, min_x + half, min_y + half, half);
+            cell = l->cells + c;
+            cell->child = child;
+            cell->body = -1;
+
+            float bx = g->x[body];
+            float by = g->y[body];
+            QuadCell *bc = l->cells + child + (bx >= min_x + half) + 2*(by >= min_y + half);
+            bc->x = bx;
+            bc->y = by;
+            bc->mass = 1;
+            bc->body = body;
+        }
+        float half = cell->size/2;
+        c = cell->child + (x >= cell->min_x + half) + 2*(y >= cell->min_y + half);
+    }
+}
+
+internal void quad_build(Layout *l, Graph *g)
+{
+    float min_x = INFINITY, min_y = INFINITY;
+    float max_x = -INFINITY, max_y = -INFINITY;
+    graph_foreach_node(g, i) {
+        min_x = fminf(min_x, g->x[i]);
+        min_y = fminf(min_y, g->y[i]);
+        max_x = fmaxf(max_x, g->x[i]);
+        max_y = fmaxf(max_y, g->y[i]);
+    }
+    da_size(l->cells) = 0;
+    quad_new_cell(l, min_x, min_y, fmaxf(max_x - min_x, max_y - min_y) + 1.0f);
+    graph_foreach_node(g, i) quad_insert(l, g, i);
+
+    for (size_t i = 0; i < da_size(l->cells); i++) {
+        QuadCell *cell = l->cells + i;
+        if (cell->mass > 0) {
+            cell->x /= cell->mass;
+            cell->y /= cell->mass;
+        }
+    }
+}
+
+// repulsion of all the other nodes on `node`, added to its displacement
+internal void layout_repulse(Layout *l, Graph *g, int node)
+{
+    const float k2 = LAYOUT_IDEAL_LENGTH*LAYOUT_IDEAL_LENGTH;
+    const float theta2 = LAYOUT_THETA*LAYOUT_THETA;
+    float x = g->x[node];
+    float y = g->y[node];
+    float fx = 0, fy = 0;
+
+    int stack[3*LAYOUT_MAX_DEPTH + 4];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        QuadCell *cell = l->cells + stack[--top];
+        if (cell->mass == 0) continue;
+        float dx = x - cell->x;
+        float dy = y - cell->y;
+        float d2 = dx*dx + dy*dy;
+        if (cell->child >= 0 && cell->size*cell->size >= theta2*d2) {
+            for (int q = 0; q < 4; q++) stack[top++] = cell->child + q;
+            continue;
+        }
+
+        float mass = cell->mass;
+        if (cell->body == node) mass -= 1;
+        if (mass == 0) continue;
+        if (d2 < 0.01f) {
+            // on top of each other, push in a direction that depends on the node
+            dx = cosf(node*IMPORT_GOLDEN_ANGLE);
+            dy = sinf(node*IMPORT_GOLDEN_ANGLE);
+            d2 = 1;
+        }
+        float f = k2*mass/d2;
+        fx += dx*f;
+        fy += dy*f;
+    }
+    l->dx[node] += fx;
+    l->dy[node] += fy;
+}
+
+typedef struct LayoutJob {
+    Layout *l;
+    Graph *g;
+} LayoutJob;
+
+internal void layout_repulse_range(void *data, int begin, int end)
+{
+    LayoutJob *job = data;
+    for (int i = begin; i < end; i++) layout_repulse(job->l, job->g, i);
+}
+
+internal void layout_iterate(Layout *l, Graph *g)
+{
+    int n = graph_num_nodes(g);
+    da_resize(l->dx, n);
+    da_resize(l->dy, n);
+    memset(l->dx, 0, n*sizeof(*l->dx));
+    memset(l->dy, 0, n*sizeof(*l->dy));
+
+    quad_build(l, g);
+    LayoutJob job = {l, g};
+    job_parallel_for(&global_jobs, n, LAYOUT_JOB_GRAIN, layout_repulse_range, &job);
+
+    graph_foreach_edge(g, i) {
+        int a = g->from[i];
+        int b = g->to[i];
+        if (a == b) continue;
+        float dx = g->x[b] - g->x[a];
+        float dy = g->y[b] - g->y[a];
+        float f = sqrtf(dx*dx + dy*dy)/LAYOUT_IDEAL_LENGTH;
+        l->dx[a] += dx*f;
+        l->dy[a] += dy*f;
+        l->dx[b] -= dx*f;
+        l->dy[b] -= dy*f;
+    }
+
+    QuadCell *root = l->cells;
+    float t = l->temperature;
+    graph_foreach_node(g, i) {
+        float dx = l->dx[i] + LAYOUT_GRAVITY*(root->x - g->x[i]);
+        float dy = l->dy[i] + LAYOUT_GRAVITY*(root->y - g->y[i]);
+        float d = sqrtf(dx*dx + dy*dy);
+        if (d > t) {
+            dx *= t/d;
+            dy *= t/d;
+        }
+        g->x[i] += dx;
+        g->y[i] += dy;
+    }
+
+    l->temperature *= LAYOUT_COOLING;
+    if (l->temperature < LAYOUT_MIN_TEMPERATURE) l->temperature = 0;
+    l->iterations++;
+}
+
+// (re)start the simulation from the current positions. the first iterations can
+// move the nodes by a tenth of the size the graph should have
+void layout_start(Layout *l, Graph *g)
+{
+    assert(!graph_has_free_slots(g) && "compact the graph first");
+    l->temperature = LAYOUT_IDEAL_LENGTH*sqrtf(graph_num_nodes(g))/10 + LAYOUT_MIN_TEMPERATURE;
+    l->iterations = 0;
+}
+
+inline internal bool layout_running(Layout *l)
+{
+    return l->temperature > 0;
+}
+
+// run iterations for about `budget_ms` milliseconds, at least one. returns the
+// number of iterations run
+int layout_step(Layout *l, Graph *g, double budget_ms)
+{
+    if (graph_num_nodes(g) == 0) l->temperature = 0;
+    double start = now_ms();
+    int n = 0;
+    while (layout_running(l) && (n == 0 || now_ms() - start < budget_ms)) {
+        layout_iterate(l, g);
+        n++;
+    }
+    return n;
+}
+
+void layout_free(Layout *l)
+{
+    da_free(l->cells);
+    da_free(l->dx);
+    da_free(l->dy);
+    *l = (Layout){0};
+}
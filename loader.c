@@ -0,0 +1,122 @@
+// Background loading
+//
+// a worker thread runs the importer and hands the batch of every chunk to the
+// main thread through a lock-free single producer, single consumer ring. the
+// main thread takes the batches between frames and appends them to its graph,
+// so the graph shows up progressively and the window never stops repainting.
+// the ring is bounded: when the main thread falls behind, the worker waits, and
+// at most LOADER_QUEUE_SIZE parsed chunks are in flight.
+//
+// only the worker touches the importer until loader_done() returns true.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define LOADER_QUEUE_SIZE 16        // power of two
+#define LOADER_WAIT_NS 1000000      // while the queue is full
+
+typedef struct BatchQueue {
+    ImportBatch items[LOADER_QUEUE_SIZE];
+    // on their own cache lines, each is written by one side only
+    _Alignas(64) atomic_size_t head;    // next to take, written by the consumer
+    _Alignas(64) atomic_size_t tail;    // next to fill, written by the producer
+} BatchQueue;
+
+typedef struct Loader {
+    Importer imp;
+    pthread_t thread;
+    BatchQueue queue;
+    atomic_bool cancel;
+    atomic_bool finished;   // the worker exited, imp.status and imp.error are final
+    int *label_map;         // label ids of the importer to those of the target graph
+    size_t bytes_done;      // by the last batch taken
+} Loader;
+
+internal bool batch_queue_push(BatchQueue *q, ImportBatch *b)
+{
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    if (tail - head == LOADER_QUEUE_SIZE) return false;
+    q->items[tail & (LOADER_QUEUE_SIZE - 1)] = *b;
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+internal bool batch_queue_pop(BatchQueue *q, ImportBatch *b)
+{
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    if (head == tail) return false;
+    *b = q->items[head & (LOADER_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return true;
+}
+
+internal void *loader_main(void *arg)
+{
+    Loader *l = arg;
+    Importer *imp = &l->imp;
+    while (imp->status == IS_RUNNING && !atomic_load(&l->cancel)) {
+        ImportBatch b;
+        import_chunk(imp, &b);
+        while (!batch_queue_push(&l->queue, &b)) {
+            if (atomic_load(&l->cancel)) {
+                import_batch_free(&b);
+                break;
+            }
+            nanosleep(&(struct timespec){0, LOADER_WAIT_NS}, NULL);
+        }
+    }
+    atomic_store(&l->finished, true);
+    return NULL;
+}
+
+// start importing `path` on a worker thread
+bool loader_start(Loader *l, const char *path, enum ImportFormat format)
+{
+    *l = (Loader){0};
+    if (!import_begin(&l->imp, path, format)) return false;
+    if (pthread_create(&l->thread, NULL, loader_main, l) != 0) {
+        TraceLog(LOG_WARNING, "LOADER: could not start the worker thread");
+        import_end(&l->imp, NULL);
+        return false;
+    }
+    return true;
+}
+
+// take the next parsed batch, if there is one. it is to be appended with
+// import_batch_apply(g, b, &l->label_map) to the graph holding the batches
+// taken before, and freed with import_batch_free()
+bool loader_next(Loader *l, ImportBatch *b)
+{
+    if (!batch_queue_pop(&l->queue, b)) return false;
+    l->bytes_done = b->bytes_done;
+    return true;
+}
+
+// the worker exited and every batch was taken
+bool loader_done(Loader *l)
+{
+    if (!atomic_load(&l->finished)) return false;
+    return atomic_load(&l->queue.head) == atomic_load(&l->queue.tail);
+}
+
+// of the batches taken
+float loader_progress(Loader *l)
+{
+    if (l->imp.file_size == 0) return 1.0f;
+    return (float)l->bytes_done/l->imp.file_size;
+}
+
+// stop the worker, when still running, and free the batches not taken
+void loader_end(Loader *l)
+{
+    atomic_store(&l->cancel, true);
+    pthread_join(l->thread, NULL);
+    ImportBatch b;
+    while (batch_queue_pop(&l->queue, &b)) import_batch_free(&b);
+    import_end(&l->imp, NULL);
+    da_free(l->label_map);
+    *l = (Loader){0};
+}
@@ -0,0 +1,52 @@
+// Level of detail
+//
+// pick how much detail to draw from the size things have on screen, given the
+// world units per pixel of the camera (GraphCtx.zoom_coef). zoomed out views of
+// big graphs then draw curves with a few segments, nodes as quads or points and
+// skip labels too small to be read.
+
+#define LOD_PIXELS_PER_SEGMENT 8.0f     // target length on screen of a curve or ring segment
+#define LOD_MIN_LABEL_PX 6.0f           // labels with a smaller font size are not drawn
+#define LOD_NODE_QUAD_PX 4.0f           // nodes with a smaller radius are drawn as quads
+#define LOD_NODE_POINT_PX 1.0f          // and below this as a single point
+#define LOD_MAX_RING_SEGMENTS 64
+#define LOD_MIN_RING_SEGMENTS 6
+
+enum NodeLod {
+    NL_POINT,
+    NL_QUAD,
+    NL_RING,
+};
+
+// number of segments for the edge curve, from the length on screen of its
+// control polygon (an upper bound of the curve length)
+inline internal int lod_curve_segments(EdgeGeo *geo, float zoom_coef, int max_segments)
+{
+    Vector2 *p = geo->points;
+    float len = Vector2Distance(p[EI_BS], p[EI_C1A]) + Vector2Distance(p[EI_C1A], p[EI_C2A])
+            + Vector2Distance(p[EI_C2A], p[EI_BE]);
+    int segments = (int)(len/(zoom_coef*LOD_PIXELS_PER_SEGMENT)) + 1;
+    return (segments < max_segments)? segments : max_segments;
+}
+
+inline internal bool lod_show_labels(float zoom_coef)
+{
+    return UI_FONT_SIZE/zoom_coef >= LOD_MIN_LABEL_PX;
+}
+
+inline internal enum NodeLod lod_node(float zoom_coef)
+{
+    float radius_px = (NODE_RADIUS + NODE_BORDER)/zoom_coef;
+    if (radius_px < LOD_NODE_POINT_PX) return NL_POINT;
+    if (radius_px < LOD_NODE_QUAD_PX)  return NL_QUAD;
+    return NL_RING;
+}
+
+inline internal int lod_ring_segments(float zoom_coef)
+{
+    float radius_px = (NODE_RADIUS + NODE_BORDER)/zoom_coef;
+    int segments = (int)ceilf(2*PI*radius_px/LOD_PIXELS_PER_SEGMENT);
+    if (segments < LOD_MIN_RING_SEGMENTS) segments = LOD_MIN_RING_SEGMENTS;
+    if (segments > LOD_MAX_RING_SEGMENTS) segments = LOD_MAX_RING_SEGMENTS;
+    return segments;
+}
@@ -0,0 +1,202 @@
+// Profiler
+//
+// scoped timers for the hot paths of a frame. every zone accumulates the time
+// spent in it during the current frame, the last PROF_HISTORY frames are kept
+// for the overlay, and while a trace is being recorded every zone is also
+// written as a Chrome trace event ("X" phase), to be opened with
+// chrome://tracing or https://ui.perfetto.dev.
+//
+//     prof_zone(PZ_HIT_TEST) {
+//         ...
+//     }
+//
+// NOTE: don't `break` or `return` out of a prof_zone() block, the zone would not
+// be closed. use prof_begin()/prof_end() around code with early exits.
+
+#define PROF_HISTORY 120
+#define PROF_OVERLAY_MAX_MS 33.3f   // full width of the overlay bars
+
+enum ProfZone {
+    PZ_IMPORT,
+    PZ_LAYOUT,
+    PZ_INPUT,
+    PZ_HIT_TEST,
+    PZ_GEOMETRY,
+    PZ_DRAW,
+    PZ_DRAW_NODES,
+    PZ_DRAW_EDGES,
+    PZ_GUI,
+
+    PZ_NUM_ZONES
+};
+
+static const char *prof_zone_names[] = {
+    [PZ_IMPORT]     = "import",
+    [PZ_LAYOUT]     = "layout",
+    [PZ_INPUT]      = "input",
+    [PZ_HIT_TEST]   = "hit test",
+    [PZ_GEOMETRY]   = "edge geometry",
+    [PZ_DRAW]       = "draw",
+    [PZ_DRAW_NODES] = "draw nodes",
+    [PZ_DRAW_EDGES] = "draw edges",
+    [PZ_GUI]        = "gui",
+};
+
+// nesting level in the overlay
+static const int prof_zone_depth[] = {
+    [PZ_IMPORT]     = 0,
+    [PZ_LAYOUT]     = 0,
+    [PZ_INPUT]      = 0,
+    [PZ_HIT_TEST]   = 1,
+    [PZ_GEOMETRY]   = 0,
+    [PZ_DRAW]       = 0,
+    [PZ_DRAW_NODES] = 1,
+    [PZ_DRAW_EDGES] = 1,
+    [PZ_GUI]        = 1,
+};
+
+static_assert(ARRAYSIZE(prof_zone_names) == PZ_NUM_ZONES);
+static_assert(ARRAYSIZE(prof_zone_depth) == PZ_NUM_ZONES);
+
+typedef struct Profiler {
+    double frame_start;
+    double start[PZ_NUM_ZONES];     // of the open zone
+    double ms[PZ_NUM_ZONES];        // spent in the current frame
+
+    // last frames, ring buffer
+    float history[PZ_NUM_ZONES][PROF_HISTORY];
+    float frame_history[PROF_HISTORY];
+    int history_pos;
+    int history_size;
+
+    FILE *trace;                    // NULL when not recording
+    double trace_origin;
+    long trace_events;
+} Profiler;
+
+global_variable Profiler global_prof;
+
+internal double now_ms(void)
+{
+    return GetTime()*1000.0;
+}
+
+inline internal void prof_begin(enum ProfZone zone)
+{
+    global_prof.start[zone] = now_ms();
+}
+
+internal void prof_trace_event(const char *name, double start, double end)
+{
+    Profiler *p = &global_prof;
+    fprintf(p->trace, "%s\n{\"name\":\"%s\",\"cat\":\"graphgui\",\"ph\":\"X\","
+            "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+            (p->trace_events > 0)? "," : "", name,
+            (start - p->trace_origin)*1000.0, (end - start)*1000.0);
+    p->trace_events++;
+}
+
+inline internal void prof_end(enum ProfZone zone)
+{
+    Profiler *p = &global_prof;
+    double end = now_ms();
+    p->ms[zone] += end - p->start[zone];
+    if (p->trace) prof_trace_event(prof_zone_names[zone], p->start[zone], end);
+}
+
+#define prof_zone(zone) \
+    for (int prof__once = (prof_begin(zone), 1); prof__once; prof__once = (prof_end(zone), 0))
+
+// time spent in `zone` during the current frame, or the last one once it ended
+inline internal double prof_ms(enum ProfZone zone)
+{
+    return global_prof.ms[zone];
+}
+
+void prof_frame_begin(void)
+{
+    Profiler *p = &global_prof;
+    memset(p->ms, 0, sizeof(p->ms));
+    p->frame_start = now_ms();
+}
+
+void prof_frame_end(void)
+{
+    Profiler *p = &global_prof;
+    double end = now_ms();
+    for (int z = 0; z < PZ_NUM_ZONES; z++)
+        p->history[z][p->history_pos] = p->ms[z];
+    p->frame_history[p->history_pos] = end - p->frame_start;
+    p->history_pos = (p->history_pos + 1) % PROF_HISTORY;
+    if (p->history_size < PROF_HISTORY) p->history_size++;
+
+    if (p->trace) prof_trace_event("frame", p->frame_start, end);
+}
+
+bool prof_trace_start(const char *path)
+{
+    Profiler *p = &global_prof;
+    assert(!p->trace);
+    p->trace = fopen(path, "w");
+    if (!p->trace) {
+        TraceLog(LOG_WARNING, "PROF: could not open trace file %s", path);
+        return false;
+    }
+    p->trace_origin = now_ms();
+    p->trace_events = 0;
+    fprintf(p->trace, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    TraceLog(LOG_INFO, "PROF: recording trace to %s", path);
+    return true;
+}
+
+void prof_trace_stop(void)
+{
+    Profiler *p = &global_prof;
+    if (!p->trace) return;
+    fprintf(p->trace, "\n]}\n");
+    fclose(p->trace);
+    p->trace = NULL;
+    TraceLog(LOG_INFO, "PROF: trace saved, %ld events", p->trace_events);
+}
+
+// table of the zones with the time of the last frame, the average and the max
+// over the history, and a bar for the average. `pos` is the top left corner
+void prof_draw_overlay(Vector2 pos)
+{
+    Profiler *p = &global_prof;
+    int font_size = 10;
+    int bar_width = 100;
+    int num_lines = PZ_NUM_ZONES + 2;
+    int x = pos.x;
+    int y = pos.y;
+    int n = (p->history_size > 0)? p->history_size : 1;
+    int last = (p->history_pos + PROF_HISTORY - 1) % PROF_HISTORY;
+
+    DrawRectangle(x - 4, y - 4, 318, num_lines*(font_size + 2) + 8, (Color){0, 0, 0, 160});
+    const char *columns[] = {"last ms", "avg", "max"};
+    for (int c = 0; c < 3; c++)
+        DrawText(columns[c], x + 90 + 40*c, y, font_size, LIGHTGRAY);
+    y += font_size + 2;
+
+    for (int z = -1; z < PZ_NUM_ZONES; z++) {
+        float *h = (z < 0)? p->frame_history : p->history[z];
+        const char *name = (z < 0)? "frame" : prof_zone_names[z];
+        int depth = (z < 0)? 0 : prof_zone_depth[z] + 1;
+
+        float sum = 0, max = 0;
+        for (int i = 0; i < p->history_size; i++) {
+            sum += h[i];
+            if (h[i] > max) max = h[i];
+        }
+        float avg = sum/n;
+
+        DrawText(name, x + 8*depth, y, font_size, LIGHTGRAY);
+        float values[] = {h[last], avg, max};
+        for (int c = 0; c < 3; c++)
+            DrawText(TextFormat("%.2f", values[c]), x + 90 + 40*c, y, font_size, LIGHTGRAY);
+        float w = bar_width*avg/PROF_OVERLAY_MAX_MS;
+        if (w > bar_width) w = bar_width;
+        DrawRectangle(x + 210, y + 1, w, font_size - 2, SKYBLUE);
+        y += font_size + 2;
+    }
+}
@@ -0,0 +1,108 @@
+// Selection
+//
+// the selected nodes and edges, as bitsets over their ids (see commons.h): an
+// item is tested with a bit test while drawing, and the selected ids are visited
+// word by word, skipping the empty words. the bitsets cover every id of the
+// graph, selection_resize() follows the graph when it grows. `version` is bumped
+// by every change, for the drawings that depend on the selection.
+
+typedef struct Selection {
+    uint64_t *nodes;        // dynamic arrays of words
+    uint64_t *edges;
+    int num_nodes;          // selected
+    int num_edges;
+    uint32_t version;
+} Selection;
+
+internal void selection_grow(uint64_t **bits, int num_ids)
+{
+    size_t words = BITSET_WORDS(num_ids);
+    size_t have = da_size(*bits);
+    if (words <= have) return;
+    graph_append_zeros(*bits, words - have);
+}
+
+void selection_resize(Selection *s, int num_nodes, int num_edges)
+{
+    selection_grow(&s->nodes, num_nodes);
+    selection_grow(&s->edges, num_edges);
+}
+
+void selection_clear(Selection *s)
+{
+    if (s->num_nodes) memset(s->nodes, 0, da_size(s->nodes)*sizeof(*s->nodes));
+    if (s->num_edges) memset(s->edges, 0, da_size(s->edges)*sizeof(*s->edges));
+    if (s->num_nodes || s->num_edges) s->version++;
+    s->num_nodes = 0;
+    s->num_edges = 0;
+}
+
+inline internal bool selection_has_node(Selection *s, int node)
+{
+    return bitset_get(s->nodes, node);
+}
+
+inline internal bool selection_has_edge(Selection *s, int edge)
+{
+    return bitset_get(s->edges, edge);
+}
+
+void selection_set_node(Selection *s, int node, bool selected)
+{
+    if (selection_has_node(s, node) == selected) return;
+    s->version++;
+    if (selected) {
+        bitset_set(s->nodes, node);
+        s->num_nodes++;
+    } else {
+        bitset_unset(s->nodes, node);
+        s->num_nodes--;
+    }
+}
+
+void selection_set_edge(Selection *s, int edge, bool selected)
+{
+    if (selection_has_edge(s, edge) == selected) return;
+    s->version++;
+    if (selected) {
+        bitset_set(s->edges, edge);
+        s->num_edges++;
+    } else {
+        bitset_unset(s->edges, edge);
+        s->num_edges--;
+    }
+}
+
+#define selection_foreach_node(s, i)                                          \
+    for (int i = bitset_next((s)->nodes, da_size((s)->nodes), 0); i >= 0;    \
+            i = bitset_next((s)->nodes, da_size((s)->nodes), i + 1))
+
+#define selection_foreach_edge(s, i)                                          \
+    for (int i = bitset_next((s)->edges, da_size((s)->edges), 0); i >= 0;    \
+            i = bitset_next((s)->edges, da_size((s)->edges), i + 1))
+
+internal void selection_remap_bits(uint64_t *bits, int *new_id)
+{
+    // new ids are never above the old ones, so a bit is only set behind the
+    // bit visited
+    for (int i = bitset_next(bits, da_size(bits), 0); i >= 0; i = bitset_next(bits, da_size(bits),
+            i + 1)) {
+        bitset_unset(bits, i);
+        bitset_set(bits, new_id[i]);
+    }
+}
+
+// follow the ids of the graph after graph_compact(), the items selected are
+// all kept
+void selection_remap(Selection *s, int *node_map, int *edge_map)
+{
+    if (s->num_nodes) selection_remap_bits(s->nodes, node_map);
+    if (s->num_edges) selection_remap_bits(s->edges, edge_map);
+}
+
+void selection_free(Selection *s)
+{
+    da_free(s->nodes);
+    da_free(s->edges);
+    *s = (Selection){0};
+}
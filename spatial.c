@@ -0,0 +1,380 @@
+// Spatial index for hit-testing
+//
+// a uniform grid over world space hashed into a fixed number of buckets. every
+// item (node, control point or label) is stored in all the cells its bounding
+// box overlaps, and the cell range it was stored with is remembered so it can be
+// moved without rebuilding the index. moving an item within the same cells costs
+// nothing, which is the usual case while dragging.
+//
+// the curve of an edge is stored with the box of its control hull, which holds
+// the whole curve. a long curve would cover a lot of cells, so curves go in
+// coarser grids too: level l has cells SPATIAL_LEVEL_SCALE^l times larger, and a
+// curve is stored at the first level where it covers at most SPATIAL_CURVE_SPAN
+// cells across. the cells of all levels share the buckets. picking measures the distance to the curves of the cell with
+// bezier_dist2(): the box of a curve, then of the halves it is split into,
+// rejects it as soon as it is farther than the pick radius, so only the curves
+// passing near the point are subdivided down to segments.
+
+#define SPATIAL_CELL_SIZE 128.0f
+#define SPATIAL_NUM_BUCKETS (1 << 16)
+#define SPATIAL_LEVELS 7            // cells of 128 to 524288 units
+#define SPATIAL_LEVEL_SCALE 4
+#define SPATIAL_CURVE_SPAN 4
+#define BEZIER_FLATNESS 0.25f       // distance of a half measured as its chord
+#define BEZIER_MAX_DEPTH 16
+
+typedef struct SpatialKey {
+    int type;   // IdType of the item
+    int id;
+} SpatialKey;
+
+// range of cells covered by an item, at a level of the grid. an empty range
+// (x0 > x1) means the item is not stored in the index
+typedef struct CellRange {
+    int x0, y0, x1, y1;
+    int level;
+} CellRange;
+
+typedef struct SpatialIndex {
+    SpatialKey **buckets;   // SPATIAL_NUM_BUCKETS dynamic arrays
+    CellRange *node_cells;
+    CellRange *ctrl_cells[2];
+    CellRange *label_cells;
+    CellRange *curve_cells;
+    int level_items[SPATIAL_LEVELS];    // items stored at each level
+} SpatialIndex;
+
+// result of a pick, following the priority of the old linear scan: the node with
+// the lowest id under the point, and the first edge item found when visiting
+// edges in order and, for each edge, control point 1, control point 2 and label.
+// the curves come last, the nearest one
+typedef struct SpatialPick {
+    int node;
+    SpatialKey edge;
+} SpatialPick;
+
+#define EMPTY_CELL_RANGE ((CellRange){0, 0, -1, -1, 0})
+
+internal uint32_t spatial_hash(int cx, int cy, int level)
+{
+    uint32_t h = (uint32_t)cx * 73856093u ^ (uint32_t)cy * 19349663u ^ (uint32_t)level * 83492791u;
+    return h & (SPATIAL_NUM_BUCKETS - 1);
+}
+
+internal CellRange spatial_cells_level(Rectangle r, int level)
+{
+    float size = SPATIAL_CELL_SIZE;
+    for (int l = 0; l < level; l++) size *= SPATIAL_LEVEL_SCALE;
+    CellRange result = {
+        (int)floorf(r.x / size),
+        (int)floorf(r.y / size),
+        (int)floorf((r.x + r.width) / size),
+        (int)floorf((r.y + r.height) / size),
+        level,
+    };
+    return result;
+}
+
+internal CellRange spatial_cells(Rectangle r)
+{
+    return spatial_cells_level(r, 0);
+}
+
+// the cells of a curve whose hull box is `r`, at the first level it fits in
+internal CellRange spatial_curve_cells(Rectangle r)
+{
+    CellRange cr;
+    for (int level = 0; level < SPATIAL_LEVELS; level++) {
+        cr = spatial_cells_level(r, level);
+        if (cr.x1 - cr.x0 < SPATIAL_CURVE_SPAN && cr.y1 - cr.y0 < SPATIAL_CURVE_SPAN) break;
+    }
+    return cr;
+}
+
+internal bool cell_range_equal(CellRange a, CellRange b)
+{
+    return a.x0 == b.x0 && a.y0 == b.y0 && a.x1 == b.x1 && a.y1 == b.y1 && a.level == b.level;
+}
+
+inline internal float point_box_dist2(Vector2 p, Vector2 lo, Vector2 hi)
+{
+    float dx = fmaxf(fmaxf(lo.x - p.x, 0.0f), p.x - hi.x);
+    float dy = fmaxf(fmaxf(lo.y - p.y, 0.0f), p.y - hi.y);
+    return dx*dx + dy*dy;
+}
+
+inline internal float point_segment_dist2(Vector2 p, Vector2 a, Vector2 b)
+{
+    Vector2 ab = Vector2Subtract(b, a);
+    Vector2 ap = Vector2Subtract(p, a);
+    float len2 = Vector2DotProduct(ab, ab);
+    float t = (len2 > 0)? Clamp(Vector2DotProduct(ap, ab)/len2, 0.0f, 1.0f) : 0.0f;
+    return Vector2DistanceSqr(p, Vector2Add(a, Vector2Scale(ab, t)));
+}
+
+// box of the control hull of the cubic Bezier curve b[0]..b[3], the curve is inside
+internal void bezier_hull_box(const Vector2 *b, Vector2 *lo, Vector2 *hi)
+{
+    *lo = b[0];
+    *hi = b[0];
+    for (int i = 1; i < 4; i++) {
+        lo->x = fminf(lo->x, b[i].x);
+        lo->y = fminf(lo->y, b[i].y);
+        hi->x = fmaxf(hi->x, b[i].x);
+        hi->y = fmaxf(hi->y, b[i].y);
+    }
+}
+
+// the squared distance from `p` to the cubic Bezier curve b[0]..b[3] when it is
+// less than `best`, else `best`. the curve is split in halves until they are
+// flat, skipping the halves whose hull box is farther than the best distance
+// found, the nearest half first
+float bezier_dist2(Vector2 p, const Vector2 *b, float best, int depth)
+{
+    // the curve is within BEZIER_FLATNESS of its chord when its control points are
+    if (depth == BEZIER_MAX_DEPTH
+            || (point_segment_dist2(b[1], b[0], b[3]) <= BEZIER_FLATNESS*BEZIER_FLATNESS
+                && point_segment_dist2(b[2], b[0], b[3]) <= BEZIER_FLATNESS*BEZIER_FLATNESS)) {
+        return fminf(best, point_segment_dist2(p, b[0], b[3]));
+    }
+
+    Vector2 ab  = Vector2Lerp(b[0], b[1], 0.5f);
+    Vector2 bc  = Vector2Lerp(b[1], b[2], 0.5f);
+    Vector2 cd  = Vector2Lerp(b[2], b[3], 0.5f);
+    Vector2 abc = Vector2Lerp(ab, bc, 0.5f);
+    Vector2 bcd = Vector2Lerp(bc, cd, 0.5f);
+    Vector2 m   = Vector2Lerp(abc, bcd, 0.5f);
+    Vector2 halves[2][4] = {{b[0], ab, abc, m}, {m, bcd, cd, b[3]}};
+
+    float d[2];
+    for (int h = 0; h < 2; h++) {
+        Vector2 lo, hi;
+        bezier_hull_box(halves[h], &lo, &hi);
+        d[h] = point_box_dist2(p, lo, hi);
+    }
+    int first = (d[1] < d[0]);
+    if (d[first] < best) best = bezier_dist2(p, halves[first], best, depth + 1);
+    if (d[1 - first] < best) best = bezier_dist2(p, halves[1 - first], best, depth + 1);
+    return best;
+}
+
+internal void spatial_insert(SpatialIndex *si, CellRange cr, SpatialKey key)
+{
+    if (cr.x0 <= cr.x1) si->level_items[cr.level]++;
+    for (int cy = cr.y0; cy <= cr.y1; cy++) {
+        for (int cx = cr.x0; cx <= cr.x1; cx++) {
+            uint32_t h = spatial_hash(cx, cy, cr.level);
+            da_append(si->buckets[h], key);
+        }
+    }
+}
+
+internal void spatial_remove(SpatialIndex *si, CellRange cr, SpatialKey key)
+{
+    if (cr.x0 <= cr.x1) si->level_items[cr.level]--;
+    for (int cy = cr.y0; cy <= cr.y1; cy++) {
+        for (int cx = cr.x0; cx <= cr.x1; cx++) {
+            SpatialKey *bucket = si->buckets[spatial_hash(cx, cy, cr.level)];
+            for (size_t i = 0; i < da_size(bucket); i++) {
+                if (bucket[i].type == key.type && bucket[i].id == key.id) {
+                    bucket[i] = bucket[da_size(bucket) - 1];
+                    da_pop(bucket);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+internal void spatial_move(SpatialIndex *si, CellRange *stored, CellRange cr, SpatialKey key)
+{
+    if (cell_range_equal(cr, *stored)) return;
+    spatial_remove(si, *stored, key);
+    spatial_insert(si, cr, key);
+    *stored = cr;
+}
+
+void spatial_init(SpatialIndex *si)
+{
+    *si = (SpatialIndex){0};
+    si->buckets = calloc(SPATIAL_NUM_BUCKETS, sizeof(*si->buckets));
+    assert(si->buckets);
+}
+
+void spatial_update_node(SpatialIndex *si, int id, Vector2 pos)
+{
+    Rectangle bounds = {pos.x - NODE_RADIUS, pos.y - NODE_RADIUS, 2*NODE_RADIUS, 2*NODE_RADIUS};
+    spatial_move(si, si->node_cells + id, spatial_cells(bounds), (SpatialKey){IT_NODE, id});
+}
+
+void spatial_update_edge(SpatialIndex *si, int id, EdgeGeo *geo)
+{
+    Vector2 c1a = geo->points[EI_C1A];
+    Vector2 c2a = geo->points[EI_C2A];
+    spatial_move(si, si->ctrl_cells[0] + id, spatial_cells((Rectangle){c1a.x, c1a.y, 0, 0}),
+            (SpatialKey){IT_CRTL_PT1, id});
+    spatial_move(si, si->ctrl_cells[1] + id, spatial_cells((Rectangle){c2a.x, c2a.y, 0, 0}),
+            (SpatialKey){IT_CRTL_PT2, id});
+    spatial_move(si, si->label_cells + id, spatial_cells(label_rect(geo)),
+            (SpatialKey){IT_LABEL, id});
+    Vector2 lo, hi;
+    bezier_hull_box(geo->points + EI_BS, &lo, &hi);
+    spatial_move(si, si->curve_cells + id,
+            spatial_curve_cells((Rectangle){lo.x, lo.y, hi.x - lo.x, hi.y - lo.y}),
+            (SpatialKey){IT_EDGE, id});
+}
+
+void spatial_add_node(SpatialIndex *si, Vector2 pos)
+{
+    int id = da_size(si->node_cells);
+    da_append(si->node_cells, EMPTY_CELL_RANGE);
+    spatial_update_node(si, id, pos);
+}
+
+// the edge is stored once its geometry is known, through spatial_update_edge()
+void spatial_add_edge(SpatialIndex *si)
+{
+    da_append(si->ctrl_cells[0], EMPTY_CELL_RANGE);
+    da_append(si->ctrl_cells[1], EMPTY_CELL_RANGE);
+    da_append(si->label_cells, EMPTY_CELL_RANGE);
+    da_append(si->curve_cells, EMPTY_CELL_RANGE);
+}
+
+// take a removed node out of the index, spatial_update_node() puts its slot back
+void spatial_remove_node(SpatialIndex *si, int id)
+{
+    spatial_remove(si, si->node_cells[id], (SpatialKey){IT_NODE, id});
+    si->node_cells[id] = EMPTY_CELL_RANGE;
+}
+
+// the same for an edge, spatial_update_edge() puts it back
+void spatial_remove_edge(SpatialIndex *si, int id)
+{
+    spatial_remove(si, si->ctrl_cells[0][id], (SpatialKey){IT_CRTL_PT1, id});
+    spatial_remove(si, si->ctrl_cells[1][id], (SpatialKey){IT_CRTL_PT2, id});
+    spatial_remove(si, si->label_cells[id], (SpatialKey){IT_LABEL, id});
+    spatial_remove(si, si->curve_cells[id], (SpatialKey){IT_EDGE, id});
+    si->ctrl_cells[0][id] = EMPTY_CELL_RANGE;
+    si->ctrl_cells[1][id] = EMPTY_CELL_RANGE;
+    si->curve_cells[id] = EMPTY_CELL_RANGE;
+    si->label_cells[id] = EMPTY_CELL_RANGE;
+}
+
+internal int64_t spatial_edge_rank(SpatialKey key)
+{
+    int sub = (key.type == IT_CRTL_PT1)? 0 : (key.type == IT_CRTL_PT2)? 1 : 2;
+    return (int64_t)key.id*3 + sub;
+}
+
+// find the items under `p`. control points are hit within `ctrl_radius` and only
+// considered when `ctrl_pts` is set, curves within `curve_radius`
+SpatialPick spatial_pick(SpatialIndex *si, Vector2 p, float ctrl_radius, bool ctrl_pts,
+        float curve_radius, Graph *g, EdgeGeo *geo)
+{
+    SpatialPick result = {-1, {IT_NONE, -1}};
+    int64_t edge_rank = INT64_MAX;
+    int curve = -1;
+    float curve_dist2 = curve_radius*curve_radius;
+
+    float r = fmaxf(ctrl_pts? ctrl_radius : 0.0f, curve_radius);
+    Rectangle box = {p.x - r, p.y - r, 2*r, 2*r};
+    for (int level = 0; level < SPATIAL_LEVELS; level++) {
+        if (si->level_items[level] == 0) continue;
+        CellRange cr = spatial_cells_level(box, level);
+        for (int cy = cr.y0; cy <= cr.y1; cy++) {
+            for (int cx = cr.x0; cx <= cr.x1; cx++) {
+                SpatialKey *bucket = si->buckets[spatial_hash(cx, cy, level)];
+                for (size_t i = 0; i < da_size(bucket); i++) {
+                    SpatialKey key = bucket[i];
+                    bool hit = false;
+                    // the other items of the coarse cells are from level 0 cells
+                    // sharing the bucket
+                    if (level > 0 && key.type != IT_EDGE) continue;
+                    switch (key.type) {
+                    case IT_NODE:
+                        if (result.node >= 0 && result.node <= key.id) continue;
+                        if (CheckCollisionPointCircle(p, graph_node_pos(g, key.id), NODE_RADIUS))
+                            result.node = key.id;
+                        continue;
+                    case IT_CRTL_PT1:
+                        hit = ctrl_pts && CheckCollisionPointCircle(p, geo[key.id].points[EI_C1A],
+                                ctrl_radius);
+                        break;
+                    case IT_CRTL_PT2:
+                        hit = ctrl_pts && CheckCollisionPointCircle(p, geo[key.id].points[EI_C2A],
+                                ctrl_radius);
+                        break;
+                    case IT_LABEL:
+                        hit = CheckCollisionPointRec(p, label_rect(geo + key.id));
+                        break;
+                    case IT_EDGE: {
+                        if (edge_rank < INT64_MAX || key.id == curve) continue;
+                        float d2 = bezier_dist2(p, geo[key.id].points + EI_BS, curve_dist2, 0);
+                        if (d2 < curve_dist2) {
+                            curve = key.id;
+                            curve_dist2 = d2;
+                        }
+                        continue;
+                    }
+                    default:
+                        UNREACHEABLE("unexpected item in spatial index");
+                    }
+                    int64_t rank = spatial_edge_rank(key);
+                    if (hit && rank < edge_rank) {
+                        edge_rank = rank;
+                        result.edge = key;
+                    }
+                }
+            }
+        }
+    }
+    if (result.edge.type == IT_NONE && curve >= 0) result.edge = (SpatialKey){IT_EDGE, curve};
+    return result;
+}
+
+internal void spatial_query_bucket(SpatialKey *bucket, Rectangle r, Graph *g, EdgeGeo *geo,
+        Arena *a, SpatialKey **out)
+{
+    for (size_t i = 0; i < da_size(bucket); i++) {
+        SpatialKey key = bucket[i];
+        if (key.type == IT_NODE) {
+            if (CheckCollisionPointRec(graph_node_pos(g, key.id), r)) arena_da_append(a, *out, key);
+        } else if (key.type == IT_LABEL) {
+            Rectangle l = label_rect(geo + key.id);
+            if (l.x >= r.x && l.y >= r.y && l.x + l.width <= r.x + r.width
+                    && l.y + l.height <= r.y + r.height)
+                arena_da_append(a, *out, key);
+        }
+    }
+}
+
+// append to `out`, in arena `a`, the nodes whose center is in `r` and the labels
+// entirely in `r`, an item can be appended more than once. a rectangle over more
+// cells than there are buckets visits each bucket once instead
+void spatial_query(SpatialIndex *si, Rectangle r, Graph *g, EdgeGeo *geo, Arena *a,
+        SpatialKey **out)
+{
+    CellRange cr = spatial_cells(r);
+    int64_t num_cells = (int64_t)(cr.x1 - cr.x0 + 1)*(cr.y1 - cr.y0 + 1);
+    if (num_cells >= SPATIAL_NUM_BUCKETS) {
+        for (size_t h = 0; h < SPATIAL_NUM_BUCKETS; h++)
+            spatial_query_bucket(si->buckets[h], r, g, geo, a, out);
+        return;
+    }
+    for (int cy = cr.y0; cy <= cr.y1; cy++)
+        for (int cx = cr.x0; cx <= cr.x1; cx++)
+            spatial_query_bucket(si->buckets[spatial_hash(cx, cy, 0)], r, g, geo, a, out);
+}
+
+void spatial_free(SpatialIndex *si)
+{
+    for (size_t i = 0; i < SPATIAL_NUM_BUCKETS; i++)
+        da_free(si->buckets[i]);
+    free(si->buckets);
+    da_free(si->node_cells);
+    da_free(si->ctrl_cells[0]);
+    da_free(si->ctrl_cells[1]);
+    da_free(si->label_cells);
+    da_free(si->curve_cells);
+    *si = (SpatialIndex){0};
+}